@@ -1,16 +1,30 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <climits>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <queue>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include <fcntl.h>
+#include <dirent.h>
 #include <omp.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define WINDOW_MOVING_STEP 4
 #define SAFE_SPACING 1600
@@ -34,7 +48,7 @@ struct LAYER
 	DIRECTION direction;
 	vector<int> conductorID;
 
-	int gridSize() { return max<int>(minWidth, minSpacing); }
+	int gridSize() const { return max<int>(minWidth, minSpacing); }
 };
 
 struct CONDUCTOR
@@ -47,23 +61,643 @@ struct DUMMY
 	bool inserted;
 	int dummyID, left, bottom, right, top, layerID;
 
-	int area() { return (right - left) * (top - bottom); }
+	int area() const { return (right - left) * (top - bottom); }
 };
 
-struct GRID
+struct IDRANGE
 {
-	GRIDTYPE type = GRIDTYPE::Empty;
-	int x, y, xSeperate = -1, ySeperate = -1;
-	bool xDensitySeperate = false, yDensitySeperate = false;
-	int density[2][2] = {{0, -1}, {-1, -1}};
-	vector<int> conductorID;
-	vector<int> dummyID;
+	const int * first, * last;
+
+	const int * begin() const { return first; }
+	const int * end() const { return last; }
+	int size() const { return int(last - first); }
+	int front() const { return *first; }
+};
+
+// Turns per-cell counts stored in start[idx] into CSR offsets. Entries are then placed
+// with list[--start[idx]] while walking the owners in reverse, which leaves start[idx]
+// at the beginning of each cell and keeps the owners in forward order inside a cell.
+template<typename T>
+void csrPrefix(vector<int> & start, vector<T> & list)
+{
+	for(size_t i = 1; i < start.size(); i++)
+		start[i] += start[i - 1];
+	list.resize(start.back());
+}
+
+// Static uniform bucket grid over rectangles {left, bottom, right, top}, bulk-loaded into
+// CSR lists. A query visits every rectangle overlapping the window exactly once without
+// allocating: a rectangle is only reported from the bucket that holds the lower-left
+// corner of its overlap with the window.
+class SPATIALINDEX
+{
+	int xMin = 0, yMin = 0, bucketSize = 1, xNum = 1, yNum = 1;
+	vector<array<int, 4>> box;
+	vector<int> boxID, start, list;
+
+	int bucketX(int x) const { return min<int>(max<int>((x - xMin) / bucketSize, 0), xNum - 1); }
+	int bucketY(int y) const { return min<int>(max<int>((y - yMin) / bucketSize, 0), yNum - 1); }
+public:
+	int bucket() const { return bucketSize; }
+
+	// Indexes shape[id] for every id in ids over the area [x0, x1) x [y0, y1)
+	template<typename SHAPE>
+	void build(const vector<SHAPE> & shape, const vector<int> & ids, int x0, int y0, int x1, int y1, int size)
+	{
+		xMin = x0;
+		yMin = y0;
+		bucketSize = max<int>(size, 1);
+		xNum = max<int>((x1 - x0 + bucketSize - 1) / bucketSize, 1);
+		yNum = max<int>((y1 - y0 + bucketSize - 1) / bucketSize, 1);
+		box.clear();
+		boxID.clear();
+		box.reserve(ids.size());
+		boxID.reserve(ids.size());
+		for(const int & id : ids)
+		{
+			box.emplace_back(array<int, 4> {shape[id].left, shape[id].bottom, shape[id].right, shape[id].top});
+			boxID.emplace_back(id);
+		}
+
+		start.assign(size_t(xNum) * yNum + 1, 0);
+		for(const auto & b : box)
+			for(int x = bucketX(b[0]); x <= bucketX(b[2] - 1); x++)
+				for(int y = bucketY(b[1]); y <= bucketY(b[3] - 1); y++)
+					start[size_t(x) * yNum + y]++;
+		csrPrefix(start, list);
+		for(int k = int(box.size()) - 1; k >= 0; k--)
+			for(int x = bucketX(box[k][0]); x <= bucketX(box[k][2] - 1); x++)
+				for(int y = bucketY(box[k][1]); y <= bucketY(box[k][3] - 1); y++)
+					list[--start[size_t(x) * yNum + y]] = k;
+	}
+
+	// Calls visit(id) for every indexed rectangle overlapping [window[0], window[2]) x [window[1], window[3])
+	template<typename VISIT>
+	void query(const array<int, 4> & window, VISIT visit) const
+	{
+		if(box.empty() || window[0] >= window[2] || window[1] >= window[3])
+			return;
+		for(int x = bucketX(window[0]); x <= bucketX(window[2] - 1); x++)
+		{
+			for(int y = bucketY(window[1]); y <= bucketY(window[3] - 1); y++)
+			{
+				const size_t bucket = size_t(x) * yNum + y;
+				for(int k = start[bucket]; k < start[bucket + 1]; k++)
+				{
+					const array<int, 4> & b = box[list[k]];
+					if(b[0] >= window[2] || b[2] <= window[0] || b[1] >= window[3] || b[3] <= window[1])
+						continue;
+					if(bucketX(max<int>(b[0], window[0])) == x && bucketY(max<int>(b[1], window[1])) == y)
+						visit(boxID[list[k]]);
+				}
+			}
+		}
+	}
+};
+
+// Flat grid of one layer. Cell (x, y) is stored at x * heightNum + y; its lower-left
+// corner is derived from the index, the small-window boundaries are kept per column
+// and per row, and the conductors / dummies covering a cell live in CSR lists. Only
+// the cells conductors cover in part have their conductors listed, over the sorted
+// cell IDs in conductorCell; a Conductor cell missing there is covered in full.
+struct GRIDMAP
+{
+	int widthNum = 0, heightNum = 0, gridSize = 0, xMin = 0, yMin = 0;
+	vector<unsigned char> cellType;
+	vector<int> xSeperate, ySeperate;
+	vector<char> xDensitySeperate, yDensitySeperate;
+	vector<size_t> conductorCell;
+	vector<int> conductorStart, conductorList;
+	vector<int> dummyStart, dummyList;
+	// Rectangle queries over the layer's conductors and over its dummies, independent of
+	// the cell size; the dummy index is built once dummyInsertion has placed them
+	SPATIALINDEX conductorIndex, dummyIndex;
+
+	size_t id(int x, int y) const { return size_t(x) * heightNum + y; }
+	size_t size() const { return cellType.size(); }
+	int x(int xIdx) const { return xMin + xIdx * gridSize; }
+	int y(int yIdx) const { return yMin + yIdx * gridSize; }
+	GRIDTYPE type(int x, int y) const { return GRIDTYPE(cellType[id(x, y)]); }
+	void setType(int x, int y, GRIDTYPE t) { cellType[id(x, y)] = t; }
+	// Callers visit cells in ID order and keep cursor, the position in conductorCell
+	// reached so far; cells covered in full give an empty range
+	IDRANGE conductorID(size_t idx, size_t & cursor) const
+	{
+		while(cursor < conductorCell.size() && conductorCell[cursor] < idx)
+			cursor++;
+		if(cursor == conductorCell.size() || conductorCell[cursor] != idx)
+			return IDRANGE {nullptr, nullptr};
+		return IDRANGE {conductorList.data() + conductorStart[cursor], conductorList.data() + conductorStart[cursor + 1]};
+	}
+	IDRANGE dummyID(size_t idx) const
+	{
+		return IDRANGE {dummyList.data() + dummyStart[idx], dummyList.data() + dummyStart[idx + 1]};
+	}
+};
+
+// Metal area of the sliding windows of one layer. The area of every small window is
+// accumulated first; build() then runs a 64-bit summed-area table over the lattice and
+// reads the WINDOW_MOVING_STEP x WINDOW_MOVING_STEP sum of every window from it. Later
+// fills are added per small window and only touch the windows covering it.
+class DENSITYMAP
+{
+	int latticeWidth, latticeHeight, windowWidth, windowHeight;
+	long long threshold;
+	vector<long long> original, window;
+
+	size_t lid(int x, int y) const { return size_t(x) * latticeHeight + y; }
+	size_t wid(int x, int y) const { return size_t(x) * windowHeight + y; }
+public:
+	// Windows x < windowNumX, y < windowNumY are tracked. A window is deficient below the
+	// smallest area the float test area < minDensity * window * window used to reject.
+	DENSITYMAP(int windowNumX, int windowNumY, float minDensity, int windowSize)
+		: latticeWidth(windowNumX + WINDOW_MOVING_STEP - 1), latticeHeight(windowNumY + WINDOW_MOVING_STEP - 1),
+		  windowWidth(max<int>(windowNumX, 0)), windowHeight(max<int>(windowNumY, 0)),
+		  original(size_t(latticeWidth) * latticeHeight, 0), window(size_t(windowWidth) * windowHeight, 0)
+	{
+		const float limit = minDensity * windowSize * windowSize;
+		threshold = max<long long>((long long)(ceil(double(limit))), 0);
+		while(threshold > 0 && float(threshold - 1) >= limit)
+			threshold--;
+		while(float(threshold) < limit)
+			threshold++;
+	}
+
+	void addOriginal(int x, int y, long long area) { original[lid(x, y)] += area; }
+
+	void build()
+	{
+		// table[x][y] holds the area of the small windows below x and below y. Rows are
+		// prefixed along y, then every column adds its left neighbour in one simd pass.
+		const int tableHeight = latticeHeight + 1;
+		vector<long long> table (size_t(latticeWidth + 1) * tableHeight, 0);
+		for(int x = 0; x < latticeWidth; x++)
+		{
+			long long * row = &table[size_t(x + 1) * tableHeight];
+			const long long * previous = &table[size_t(x) * tableHeight];
+			const long long * area = &original[lid(x, 0)];
+			for(int y = 0; y < latticeHeight; y++)
+				row[y + 1] = row[y] + area[y];
+			#pragma omp simd
+			for(int y = 0; y < tableHeight; y++)
+				row[y] += previous[y];
+		}
+		for(int x = 0; x < windowWidth; x++)
+		{
+			const long long * low = &table[size_t(x) * tableHeight];
+			const long long * high = &table[size_t(x + WINDOW_MOVING_STEP) * tableHeight];
+			long long * sum = &window[wid(x, 0)];
+			#pragma omp simd
+			for(int y = 0; y < windowHeight; y++)
+				sum[y] = high[y + WINDOW_MOVING_STEP] - low[y + WINDOW_MOVING_STEP] - high[y] + low[y];
+		}
+	}
+
+	long long area(int x, int y) const { return window[wid(x, y)]; }
+	bool deficient(int x, int y) const { return window[wid(x, y)] < threshold; }
+
+	// Adds area to small window (X, Y) and calls reached(x, y) for every window that stops
+	// being deficient because of it; returns the number of windows updated
+	template<typename VISIT>
+	int add(int X, int Y, long long area, VISIT reached)
+	{
+		int updated = 0;
+		for(int x = max<int>(X - WINDOW_MOVING_STEP + 1, 0); x <= min<int>(X, windowWidth - 1); x++)
+		{
+			for(int y = max<int>(Y - WINDOW_MOVING_STEP + 1, 0); y <= min<int>(Y, windowHeight - 1); y++)
+			{
+				long long & sum = window[wid(x, y)];
+				const bool wasDeficient = sum < threshold;
+				sum += area;
+				updated++;
+				if(wasDeficient && sum >= threshold)
+					reached(x, y);
+			}
+		}
+		return updated;
+	}
+};
+
+// Reserved dummies that could serve each small window, as one CSR pool per layer. The
+// candidates of a window are sorted by decreasing area, then by ID; promoted dummies are
+// skipped lazily through a per-window cursor, so the best one left is found in O(1)
+// amortized.
+struct CANDIDATEPOOL
+{
+	vector<int> start, list, cursor;
+
+	// pair holds {window, dummy ID} entries, duplicates allowed; it is consumed
+	void build(int windowNum, vector<array<int, 2>> & pair, const vector<DUMMY> & dummyInfo)
+	{
+		sort(pair.begin(), pair.end(), [&](const array<int, 2> & a, const array<int, 2> & b)
+		{
+			if(a[0] != b[0])
+				return a[0] < b[0];
+			else if(dummyInfo[a[1]].area() != dummyInfo[b[1]].area())
+				return dummyInfo[a[1]].area() > dummyInfo[b[1]].area();
+			else
+				return a[1] < b[1];
+		});
+		pair.erase(unique(pair.begin(), pair.end()), pair.end());
+		start.assign(windowNum + 1, 0);
+		list.resize(pair.size());
+		for(size_t i = 0; i < pair.size(); i++)
+		{
+			start[pair[i][0] + 1]++;
+			list[i] = pair[i][1];
+		}
+		for(int i = 1; i <= windowNum; i++)
+			start[i] += start[i - 1];
+		cursor.assign(start.begin(), start.end() - 1);
+		vector<array<int, 2>> ().swap(pair);
+	}
+
+	// Largest dummy of the window that is not inserted yet, -1 if there is none
+	int best(int window, const vector<DUMMY> & dummyInfo)
+	{
+		int & now = cursor[window];
+		while(now < start[window + 1] && dummyInfo[list[now]].inserted)
+			now++;
+		return now < start[window + 1] ? list[now] : -1;
+	}
+};
+
+// Whitespace-separated number reader over the whole input held in memory. Regular files
+// are mmap'd (zero-copy); stdin ("-"), pipes and anything mmap refuses are slurped instead.
+struct INPUTBUFFER
+{
+	const char * now = nullptr, * end = nullptr;
+	void * mapped = nullptr;
+	size_t mappedSize = 0;
+	string owned;
+
+	bool open(const char * file)
+	{
+		const bool standardInput = (string(file) == "-");
+		const int fd = standardInput ? STDIN_FILENO : ::open(file, O_RDONLY);
+		if(fd < 0)
+			return false;
+
+		struct stat status;
+		if(!standardInput && fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+		{
+			void * data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(data != MAP_FAILED)
+			{
+				madvise(data, status.st_size, MADV_SEQUENTIAL);
+				mapped = data;
+				mappedSize = status.st_size;
+				now = static_cast<const char *>(data);
+				end = now + mappedSize;
+				::close(fd);
+				return true;
+			}
+		}
+
+		char chunk[1 << 16];
+		ssize_t length;
+		while((length = read(fd, chunk, sizeof(chunk))) > 0)
+			owned.append(chunk, length);
+		if(!standardInput)
+			::close(fd);
+		now = owned.data();
+		end = now + owned.size();
+		return true;
+	}
+
+	void close()
+	{
+		if(mapped != nullptr)
+			munmap(mapped, mappedSize);
+		mapped = nullptr;
+		owned.clear();
+		now = end = nullptr;
+	}
+
+	void skipSpace()
+	{
+		while(now < end && (*now == ' ' || *now == '\n' || *now == '\r' || *now == '\t' || *now == '\v' || *now == '\f'))
+			now++;
+	}
+
+	int readInt()
+	{
+		skipSpace();
+		bool negative = false;
+		if(now < end && (*now == '-' || *now == '+'))
+			negative = (*now++ == '-');
+		int value = 0;
+		while(now < end && *now >= '0' && *now <= '9')
+			value = value * 10 + (*now++ - '0');
+		return negative ? -value : value;
+	}
+
+	// Only a handful of floats per file, so they go through strtof (the same conversion
+	// istream uses) on a terminated copy to stay bit-identical with the old reader.
+	float readFloat()
+	{
+		skipSpace();
+		char token[64];
+		int length = 0;
+		while(now < end && length < 63 && !(*now == ' ' || *now == '\n' || *now == '\r' || *now == '\t' || *now == '\v' || *now == '\f'))
+			token[length++] = *now++;
+		token[length] = '\0';
+		return strtof(token, nullptr);
+	}
+};
+
+// Binary max-heap of lattice IDs ordered by (key[id], stamp[id]). The position of every
+// ID is tracked, so each change of one ID's key or stamp is repaired by update(id) in
+// O(log n); changes must not be batched before calling update.
+class INDEXEDHEAP
+{
+	vector<int> heap, position;
+	const vector<int> & key;
+	const vector<int> & stamp;
+
+	bool before(int a, int b) const { return key[a] != key[b] ? key[a] > key[b] : stamp[a] > stamp[b]; }
+	void place(int index, int id)
+	{
+		heap[index] = id;
+		position[id] = index;
+	}
+	void siftUp(int index)
+	{
+		const int id = heap[index];
+		while(index > 0 && before(id, heap[(index - 1) / 2]))
+		{
+			place(index, heap[(index - 1) / 2]);
+			index = (index - 1) / 2;
+		}
+		place(index, id);
+	}
+	void siftDown(int index)
+	{
+		const int id = heap[index];
+		const int size = int(heap.size());
+		while(2 * index + 1 < size)
+		{
+			int child = 2 * index + 1;
+			if(child + 1 < size && before(heap[child + 1], heap[child]))
+				child++;
+			if(!before(heap[child], id))
+				break;
+			place(index, heap[child]);
+			index = child;
+		}
+		place(index, id);
+	}
+public:
+	INDEXEDHEAP(int size, const vector<int> & keyRef, const vector<int> & stampRef)
+		: position(size, -1), key(keyRef), stamp(stampRef) {}
+
+	bool empty() const { return heap.empty(); }
+	bool contains(int id) const { return position[id] >= 0; }
+	int top() const { return heap.front(); }
+	void push(int id)
+	{
+		heap.emplace_back(id);
+		siftUp(int(heap.size()) - 1);
+	}
+	void remove(int id)
+	{
+		const int index = position[id];
+		position[id] = -1;
+		const int last = heap.back();
+		heap.pop_back();
+		if(index < int(heap.size()))
+		{
+			place(index, last);
+			update(last);
+		}
+	}
+	void pop() { remove(heap.front()); }
+	void update(int id)
+	{
+		siftUp(position[id]);
+		siftDown(position[id]);
+	}
+};
+
+// Bitsets stored as 64-bit words, bit i being bit i % 64 of word i / 64. Ranges are
+// inclusive and handled a word at a time.
+unsigned long long wordMask(int word, int first, int last)
+{
+	unsigned long long bits = ~0ULL;
+	if(word == first / 64)
+		bits &= ~0ULL << (first % 64);
+	if(word == last / 64 && last % 64 != 63)
+		bits &= (1ULL << (last % 64 + 1)) - 1;
+	return bits;
+}
+
+bool anyBit(const unsigned long long * words, int first, int last)
+{
+	for(int word = first / 64; word <= last / 64; word++)
+		if(words[word] & wordMask(word, first, last))
+			return true;
+	return false;
+}
+
+void clearBits(unsigned long long * words, int first, int last)
+{
+	for(int word = first / 64; word <= last / 64; word++)
+		words[word] &= ~wordMask(word, first, last);
+}
+
+void setBits(unsigned long long * words, int first, int last)
+{
+	for(int word = first / 64; word <= last / 64; word++)
+		words[word] |= wordMask(word, first, last);
+}
+
+// First set bit in [first, last], -1 if there is none
+int nextBit(const unsigned long long * words, int first, int last)
+{
+	for(int word = first / 64; word <= last / 64; word++)
+	{
+		const unsigned long long bits = words[word] & wordMask(word, first, last);
+		if(bits)
+			return word * 64 + __builtin_ctzll(bits);
+	}
+	return -1;
+}
+
+// One bit per cell of a grid, stored column by column with every column padded to
+// whole words, so that strips of columns never share a word
+struct CELLBITS
+{
+	int columnWords;
+	vector<unsigned long long> word;
+
+	CELLBITS(int widthNum, int heightNum) : columnWords((heightNum + 63) / 64), word(size_t(widthNum) * columnWords, 0) {}
+	unsigned long long * column(int x) { return word.data() + size_t(x) * columnWords; }
+	const unsigned long long * column(int x) const { return word.data() + size_t(x) * columnWords; }
+	bool test(int x, int y) const { return column(x)[y / 64] >> (y % 64) & 1; }
+};
+
+// Small windows of the density lattice that still need dummies, stored once per column
+// and once per row as 64-bit words so that a strip along a region border is tested a
+// word at a time.
+class DEFICITMAP
+{
+	int widthNum, heightNum, columnWords, rowWords;
+	vector<unsigned long long> column, row;
+public:
+	DEFICITMAP(int width, int height) : widthNum(width), heightNum(height),
+		columnWords((height + 63) / 64), rowWords((width + 63) / 64),
+		column(size_t(width) * columnWords, 0), row(size_t(height) * rowWords, 0) {}
+
+	int width() const { return widthNum; }
+	int height() const { return heightNum; }
+	void set(int x, int y)
+	{
+		column[size_t(x) * columnWords + y / 64] |= 1ULL << (y % 64);
+		row[size_t(y) * rowWords + x / 64] |= 1ULL << (x % 64);
+	}
+	// Whether any cell of column x between yFirst and yLast (inclusive) is set
+	bool columnAny(int x, int yFirst, int yLast) const { return anyBit(&column[size_t(x) * columnWords], yFirst, yLast); }
+	bool rowAny(int y, int xFirst, int xLast) const { return anyBit(&row[size_t(y) * rowWords], xFirst, xLast); }
+	void clear(const array<int, 4> & box)
+	{
+		for(int x = box[0]; x <= box[2]; x++)
+			clearBits(&column[size_t(x) * columnWords], box[1], box[3]);
+		for(int y = box[1]; y <= box[3]; y++)
+			clearBits(&row[size_t(y) * rowWords], box[0], box[2]);
+	}
+	// Advances (x, y) to the first set cell at or after it, rows first when byRow is set
+	// (the order of y * width + x) and columns first otherwise; false when none is left.
+	bool next(int & x, int & y, bool byRow) const
+	{
+		if(byRow)
+		{
+			for(; y < heightNum; y++, x = 0)
+			{
+				x = x < widthNum ? nextBit(&row[size_t(y) * rowWords], x, widthNum - 1) : -1;
+				if(x >= 0 && x < widthNum)
+					return true;
+				x = 0;
+			}
+		}
+		else
+		{
+			for(; x < widthNum; x++, y = 0)
+			{
+				y = y < heightNum ? nextBit(&column[size_t(x) * columnWords], y, heightNum - 1) : -1;
+				if(y >= 0 && y < heightNum)
+					return true;
+				y = 0;
+			}
+		}
+		return false;
+	}
+};
+
+// Cells of a grid view that dummyInsertion may still start a dummy on (Empty or
+// Critical), one bitset per line of constant u. Cells only ever leave the set, so the
+// next free cell across the tracks is found a word at a time.
+class FREEMAP
+{
+	int lineWords;
+	vector<unsigned long long> bits;
+public:
+	// Cell (u, v) is cell[u * uStride + v * vStride]. The map is built a word at a time
+	// and word by word across the lines, so a transposed view still reads the cells of
+	// 64 neighbouring lines together.
+	FREEMAP(int uNum, int vNum, const unsigned char * cell, size_t uStride, size_t vStride)
+		: lineWords((vNum + 63) / 64), bits(size_t(uNum) * lineWords, 0)
+	{
+		for(int word = 0; word < lineWords; word++)
+		{
+			const int length = min<int>(64, vNum - word * 64);
+			for(int u = 0; u < uNum; u++)
+			{
+				const unsigned char * run = cell + u * uStride + size_t(word) * 64 * vStride;
+				unsigned long long value = 0;
+				for(int b = 0; b < length; b++)
+					value |= (unsigned long long)(run[b * vStride] <= GRIDTYPE::Critical) << b;
+				bits[size_t(u) * lineWords + word] = value;
+			}
+		}
+	}
+
+	bool test(int u, int v) const { return (bits[size_t(u) * lineWords + v / 64] >> (v % 64)) & 1; }
+	void clear(int u, int vFirst, int vLast) { clearBits(&bits[size_t(u) * lineWords], vFirst, vLast); }
+	// First free v of line u in [vFirst, vLast], -1 if there is none
+	int next(int u, int vFirst, int vLast) const
+	{
+		return vFirst <= vLast ? nextBit(&bits[size_t(u) * lineWords], vFirst, vLast) : -1;
+	}
+};
+
+struct STAGESTAT
+{
+	double seconds = 0;
+	long long cellsScanned = 0;
+};
+
+// Per-layer instrumentation, filled by the stages and dumped as JSON next to the output
+struct LAYERSTAT
+{
+	int gridWidthNum = 0, gridHeightNum = 0;
+	STAGESTAT gridCreation, dummyInsertion, densityMap, critical, regionExtraction, regionFill;
+	long long queuePushes = 0, queuePops = 0;
+	long long dummiesCreated = 0, dummiesReserved = 0, dummiesPromoted = 0;
+	long long insertionStrips = 0, seamMerges = 0;
+	long long regions = 0, regionDummies = 0;
+	long long tiles = 0, tileDummiesDropped = 0;
+	long long ecoZones = 0, ecoDummiesRemoved = 0;
+	long long cacheHits = 0;
+	double seconds = 0;
 };
 
-struct DENSITYGRID
+// Accumulates the statistics of one tile into those of its layer
+void addStat(LAYERSTAT & total, const LAYERSTAT & part)
+{
+	auto addStage = [](STAGESTAT & a, const STAGESTAT & b)
+	{
+		a.seconds += b.seconds;
+		a.cellsScanned += b.cellsScanned;
+	};
+	total.gridWidthNum = max<int>(total.gridWidthNum, part.gridWidthNum);
+	total.gridHeightNum = max<int>(total.gridHeightNum, part.gridHeightNum);
+	addStage(total.gridCreation, part.gridCreation);
+	addStage(total.dummyInsertion, part.dummyInsertion);
+	addStage(total.densityMap, part.densityMap);
+	addStage(total.critical, part.critical);
+	addStage(total.regionExtraction, part.regionExtraction);
+	addStage(total.regionFill, part.regionFill);
+	total.queuePushes += part.queuePushes;
+	total.queuePops += part.queuePops;
+	total.dummiesCreated += part.dummiesCreated;
+	total.dummiesReserved += part.dummiesReserved;
+	total.dummiesPromoted += part.dummiesPromoted;
+	total.insertionStrips = max<long long>(total.insertionStrips, part.insertionStrips);
+	total.seamMerges += part.seamMerges;
+	total.regions += part.regions;
+	total.regionDummies += part.regionDummies;
+	total.tiles += part.tiles;
+	total.tileDummiesDropped += part.tileDummiesDropped;
+	total.ecoZones += part.ecoZones;
+	total.ecoDummiesRemoved += part.ecoDummiesRemoved;
+	total.cacheHits += part.cacheHits;
+}
+
+// Adds the wall time between construction and stop() (or the end of the scope) to seconds
+class STAGETIMER
 {
-	unsigned original = 0, window = 0;
-	unordered_set<int> criticalDummyID;
+	double & seconds;
+	chrono::steady_clock::time_point start;
+	bool running = true;
+public:
+	STAGETIMER(double & target) : seconds(target), start(chrono::steady_clock::now()) {}
+	~STAGETIMER() { stop(); }
+	void stop()
+	{
+		if(running)
+			seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		running = false;
+	}
 };
 
 void readFile(const char * file,
@@ -72,16 +706,27 @@ void readFile(const char * file,
 			  CRITICALNET & criticalNet, vector<LAYER> & layerInfo,
 			  vector<CONDUCTOR> & conductorInfo)
 {
-	fstream input;
-	input.open(file, ios::in);
-
-	input >> xMin >> yMin >> xMax >> yMax >> window
-		  >> numCritical >> numLayer >> numConductor;
+	INPUTBUFFER input;
+	if(!input.open(file))
+	{
+		cerr << "Cannot open input file " << file << endl;
+		exit(1);
+	}
 
+	xMin = input.readInt();
+	yMin = input.readInt();
+	xMax = input.readInt();
+	yMax = input.readInt();
+	window = input.readInt();
+	numCritical = input.readInt();
+	numLayer = input.readInt();
+	numConductor = input.readInt();
+
+	criticalNet.netID.reserve(numCritical);
+	criticalNet.conductorID.reserve(numCritical);
 	for(int i = 0; i < numCritical; i++)
 	{
-		int tmp;
-		input >> tmp;
+		int tmp = input.readInt();
 		criticalNet.netID.emplace(tmp);
 		criticalNet.conductorID[tmp];
 	}
@@ -89,42 +734,355 @@ void readFile(const char * file,
 	layerInfo.resize(numLayer + 1);
 	for(int i = 0; i < numLayer; i++)
 	{
-		int a, b, c, d;
-		float e, f, g;
-		input >> a >> b >> c >> d >> e >> f >> g;
+		int a = input.readInt(), b = input.readInt(), c = input.readInt(), d = input.readInt();
+		float e = input.readFloat(), f = input.readFloat(), g = input.readFloat();
 		LAYER tmp = {.layerID = a, .minWidth = b, .minSpacing = c, .maxWidth = d,
 					 .minDensity = e, .maxDensity = f, .weight = g};
 		layerInfo[a] = tmp;
 	}
 
+	// Conductors are read in one pass that counts them per layer and per critical net;
+	// the ID lists are filled afterwards in input order so that each of them is reserved
+	// exactly once. netList keeps the critical net list of every conductor read.
 	conductorInfo.resize(numConductor + 1);
+	vector<int> inputOrder (numConductor);
+	vector<int> layerCount (numLayer + 1, 0);
+	vector<vector<int> *> netList (numConductor, nullptr);
+	unordered_map<int, int> netCount;
+	netCount.reserve(numCritical);
 	for(int i = 0; i < numConductor; i++)
 	{
-		int a, b, c, d, e, f, g;
-		input >> a >> b >> c >> d >> e >> f >> g;
+		int a = input.readInt(), b = input.readInt(), c = input.readInt(), d = input.readInt(),
+			e = input.readInt(), f = input.readInt(), g = input.readInt();
 		CONDUCTOR tmp = {.conductorID = a, .left = b, .bottom = c, .right = d, .top = e,
 						 .netID = f, .layerID = g};
 		conductorInfo[a] = tmp;
+		inputOrder[i] = a;
+		layerCount[g]++;
+		auto net = criticalNet.conductorID.find(f);
+		if(net != criticalNet.conductorID.end())
+		{
+			netList[i] = &net->second;
+			netCount[f]++;
+		}
+	}
+	input.close();
 
-		if(criticalNet.netID.find(f) != criticalNet.netID.end())
-			criticalNet.conductorID[f].emplace_back(a);
+	for(int i = 1; i <= numLayer; i++)
+		layerInfo[i].conductorID.reserve(layerCount[i]);
+	for(const auto & count : netCount)
+		criticalNet.conductorID[count.first].reserve(count.second);
+	for(int i = 0; i < numConductor; i++)
+	{
+		const int & a = inputOrder[i];
+		if(netList[i] != nullptr)
+			netList[i]->emplace_back(a);
 
-		layerInfo[g].conductorID.emplace_back(a);
+		layerInfo[conductorInfo[a].layerID].conductorID.emplace_back(a);
+	}
+}
+
+// Applies an ECO delta to the design read by readFile. The delta holds one record per
+// line, either "- <conductorID>" to remove a conductor or
+// "+ <conductorID> <left> <bottom> <right> <top> <netID> <layerID>" to add one; adding
+// an ID already in the design replaces that conductor. The layer lists keep their order
+// with the added conductors appended in delta order, and changed[layer] collects the
+// old and the new shape of every conductor the delta touches.
+bool readDelta(const char * file, int numLayer, CRITICALNET & criticalNet, vector<LAYER> & layerInfo,
+			   vector<CONDUCTOR> & conductorInfo, vector<vector<CONDUCTOR>> & changed)
+{
+	INPUTBUFFER input;
+	if(!input.open(file))
+	{
+		cerr << "Cannot open delta file " << file << endl;
+		return false;
 	}
 
+	// present: in the design now, fresh: added by this delta
+	vector<char> present (conductorInfo.size(), false), fresh (conductorInfo.size(), false), touched (numLayer + 1, false);
+	for(int i = 1; i <= numLayer; i++)
+		for(const int & id : layerInfo[i].conductorID)
+			present[id] = true;
+	vector<int> added;
+	changed.assign(numLayer + 1, vector<CONDUCTOR> ());
+	auto drop = [&](int id)
+	{
+		const CONDUCTOR & conductor = conductorInfo[id];
+		present[id] = false;
+		touched[conductor.layerID] = true;
+		changed[conductor.layerID].emplace_back(conductor);
+		auto net = criticalNet.conductorID.find(conductor.netID);
+		if(net != criticalNet.conductorID.end())
+			net->second.erase(remove(net->second.begin(), net->second.end(), id), net->second.end());
+	};
+
+	bool valid = true;
+	input.skipSpace();
+	while(valid && input.now < input.end)
+	{
+		const char operation = *input.now++;
+		const int id = input.readInt();
+		if(operation == '-')
+		{
+			valid = (id >= 0 && id < int(present.size()) && present[id]);
+			if(valid)
+				drop(id);
+		}
+		else if(operation == '+')
+		{
+			const int b = input.readInt(), c = input.readInt(), d = input.readInt(), e = input.readInt(),
+					  f = input.readInt(), g = input.readInt();
+			valid = (id >= 0 && g >= 1 && g <= numLayer && b < d && c < e);
+			if(valid)
+			{
+				if(id < int(present.size()) && present[id])
+					drop(id);
+				if(id >= int(conductorInfo.size()))
+				{
+					conductorInfo.resize(id + 1);
+					present.resize(id + 1, false);
+					fresh.resize(id + 1, false);
+				}
+				CONDUCTOR tmp = {.conductorID = id, .left = b, .bottom = c, .right = d, .top = e,
+								 .netID = f, .layerID = g};
+				conductorInfo[id] = tmp;
+				present[id] = fresh[id] = true;
+				touched[g] = true;
+				changed[g].emplace_back(tmp);
+				added.emplace_back(id);
+				if(criticalNet.netID.find(f) != criticalNet.netID.end())
+					criticalNet.conductorID[f].emplace_back(id);
+			}
+		}
+		else
+			valid = false;
+		input.skipSpace();
+	}
 	input.close();
+	if(!valid)
+	{
+		cerr << "Invalid record in delta file " << file << endl;
+		return false;
+	}
+
+	for(int i = 1; i <= numLayer; i++)
+	{
+		if(!touched[i])
+			continue;
+		vector<int> & list = layerInfo[i].conductorID;
+		list.erase(remove_if(list.begin(), list.end(), [&](int id) { return !present[id] || fresh[id]; }), list.end());
+	}
+	for(const int & id : added)
+	{
+		if(present[id] && fresh[id])
+		{
+			layerInfo[conductorInfo[id].layerID].conductorID.emplace_back(id);
+			fresh[id] = false;
+		}
+	}
+	return true;
 }
 
-vector<vector<GRID>> gridCreation(const int & xMin, const int & xMax, const int & yMin, const int & yMax,
-								  const int & window, const CRITICALNET & criticalNet, LAYER & layer,
-								  const vector<CONDUCTOR> & conductorInfo)
+// Grid of one layer seen along its routing direction: u runs along the tracks and v
+// across them, i.e. (x, y) on horizontal layers and (y, x) on vertical ones. Kernels
+// written against the view are instantiated once per direction, so the transposition
+// is resolved at compile time.
+template<DIRECTION D>
+struct GRIDVIEW
 {
+	GRIDMAP & grid;
+
+	int uNum() const { return D == DIRECTION::Horizontal ? grid.widthNum : grid.heightNum; }
+	int vNum() const { return D == DIRECTION::Horizontal ? grid.heightNum : grid.widthNum; }
+	size_t id(int u, int v) const { return D == DIRECTION::Horizontal ? grid.id(u, v) : grid.id(v, u); }
+	GRIDTYPE type(int u, int v) const { return GRIDTYPE(grid.cellType[id(u, v)]); }
+	unsigned char & cell(int u, int v) { return grid.cellType[id(u, v)]; }
+	// Grid (x, y) of a view (u, v), and the other way round
+	static array<int, 2> swap(int u, int v) { return D == DIRECTION::Horizontal ? array<int, 2> {u, v} : array<int, 2> {v, u}; }
+};
+
+// Critical marking of gridCreation along u. Each critical conductor walks out of both
+// of its sides on every line v it spans, from two cells off (past its Spacing halo) up
+// to its reach, turning Empty cells Critical until it meets a wall: a conductor cell
+// whose two neighbours across the line are conductors too. A line is swept once per
+// side in start order carrying the farthest reach of the walks not yet walled off, so
+// cells shared by several walks are visited once and the same cells get marked as when
+// walking the conductors one by one. Lines only change their own cells, so blocks of
+// them run in parallel. Boxes are in grid (x, y): cells, then reach; coverCell flags
+// the cells conductors overlap.
+template<DIRECTION D>
+long long criticalPass(GRIDVIEW<D> view, const CELLBITS & coverCell, const vector<array<int, 8>> & critical, const int & threads)
+{
+	const int uNum = view.uNum(), vNum = view.vNum();
+	auto toView = [](const array<int, 8> & box, int k)
+	{
+		return D == DIRECTION::Horizontal ? array<int, 4> {box[k], box[k + 1], box[k + 2], box[k + 3]}
+										  : array<int, 4> {box[k + 1], box[k], box[k + 3], box[k + 2]};
+	};
+
+	// Cells are reached through plain pointers and strides: every cell written could
+	// otherwise alias the grid and the sweep state
+	unsigned char * const cellType = view.grid.cellType.data();
+	const unsigned long long * const cover = coverCell.word.data();
+	const int columnWords = coverCell.columnWords;
+	const size_t uStride = view.id(1, 0) - view.id(0, 0), vStride = view.id(0, 1) - view.id(0, 0);
+	auto isConductor = [&](int u, int v)
+	{
+		const array<int, 2> xy = GRIDVIEW<D>::swap(u, v);
+		return cover[size_t(xy[0]) * columnWords + xy[1] / 64] >> (xy[1] % 64) & 1;
+	};
+	// Only asked of Conductor cells; the neighbours' types may be changing in other lines
+	auto isWall = [&](int u, int v)
+	{
+		return isConductor(u, max<int>(v - 1, 0)) && isConductor(u, min<int>(v + 1, vNum - 1));
+	};
+
+	// Lines go in blocks, and rows, being strided in memory, are swept together in tiles
+	// of u so that the cells a tile touches stay cached while the block goes through it.
+	// A column is contiguous and is swept on its own in one go.
+	const int block = 32;
+	const int tile = D == DIRECTION::Horizontal ? 64 : uNum;
+	const int blockNum = (vNum + block - 1) / block, tileNum = (uNum + tile - 1) / tile;
+
+	// Walks of every block as (start, reach, first line, last line) in CSR, farthest
+	// start first. Walks towards higher u are mirrored (negated) so that both sides walk
+	// downwards.
+	auto walkList = [&](int sign, vector<int> & start, vector<array<int, 4>> & list)
+	{
+		vector<array<int, 4>> walk;
+		walk.reserve(critical.size());
+		for(const array<int, 8> & box : critical)
+		{
+			const array<int, 4> cell = toView(box, 0), reach = toView(box, 4);
+			const int from = sign > 0 ? cell[0] - 2 : cell[2] + 2;
+			// A walk clamped onto the die edge starts on the halo or the conductor, and marks nothing
+			if(from >= 0 && from < uNum && cell[1] <= cell[3])
+				walk.emplace_back(array<int, 4> {sign * from, sign * (sign > 0 ? reach[0] : reach[2]),
+												 max<int>(cell[1], 0), min<int>(cell[3], vNum - 1)});
+		}
+		sort(walk.begin(), walk.end(), greater<array<int, 4>>());
+		start.assign(blockNum + 1, 0);
+		for(const array<int, 4> & w : walk)
+			for(int b = w[2] / block; b <= w[3] / block; b++)
+				start[b]++;
+		csrPrefix(start, list);
+		for(auto iter = walk.rbegin(); iter != walk.rend(); iter++)
+			for(int b = (*iter)[2] / block; b <= (*iter)[3] / block; b++)
+				list[--start[b]] = *iter;
+	};
+	vector<int> lowerStart, upperStart;
+	vector<array<int, 4>> lowerList, upperList;
+	walkList(1, lowerStart, lowerList);
+	walkList(-1, upperStart, upperList);
+
+	long long scanned = 0;
+	#pragma omp parallel num_threads(threads) reduction(+ : scanned)
+	{
+		// Where the sweep of each line of the block stands: next walk, reach of the walks
+		// running and current cell
+		struct SWEEP { int k, reach, w; };
+		vector<SWEEP> lower (block), upper (block);
+		// Sweeps down to w = stop, pausing there if a walk is still running
+		auto sweep = [&](SWEEP & line, const vector<array<int, 4>> & list, int end, int sign, int v, int stop)
+		{
+			// Walks of the block not on this line are passed over
+			auto skip = [&](int k)
+			{
+				while(k < end && (list[k][2] > v || list[k][3] < v))
+					k++;
+				return k;
+			};
+			int k = skip(line.k), reach = line.reach, w = line.w;
+			while(true)
+			{
+				// With no walk running, jump to the next start
+				if(reach == INT_MAX)
+				{
+					if(k == end || list[k][0] < stop)
+						break;
+					w = list[k][0];
+				}
+				for(; k < end && list[k][0] >= w; k = skip(k + 1))
+					reach = min<int>(reach, list[k][1]);
+
+				// Walk until the reach, the next start or the pause, whichever comes first
+				const int next = max<int>(max<int>(k < end ? list[k][0] : INT_MIN, stop - 1), reach - 1);
+				const int from = w;
+				bool walled = false;
+				for(; w > next; w--)
+				{
+					unsigned char & nowCell = cellType[sign * w * uStride + v * vStride];
+					if(nowCell == GRIDTYPE::Empty)
+						nowCell = GRIDTYPE::Critical;
+					else if(nowCell == GRIDTYPE::Conductor && isWall(sign * w, v))
+					{
+						walled = true;
+						break;
+					}
+				}
+				scanned += from - w + walled;
+				if(walled || w == reach - 1)
+					reach = INT_MAX;
+				else if(w == stop - 1)
+					break;
+			}
+			line = SWEEP {k, reach, w};
+		};
+		#pragma omp for schedule(dynamic, 1)
+		for(int blockID = 0; blockID < blockNum; blockID++)
+		{
+			const int vFirst = blockID * block, lineNum = min<int>(vFirst + block, vNum) - vFirst;
+			for(int b = 0; b < lineNum; b++)
+			{
+				lower[b] = SWEEP {lowerStart[blockID], INT_MAX, 0};
+				upper[b] = SWEEP {upperStart[blockID], INT_MAX, 0};
+			}
+			for(int t = tileNum - 1; t >= 0; t--)
+				for(int b = 0; b < lineNum; b++)
+					sweep(lower[b], lowerList, lowerStart[blockID + 1], 1, vFirst + b, t * tile);
+			for(int t = 0; t < tileNum; t++)
+				for(int b = 0; b < lineNum; b++)
+					sweep(upper[b], upperList, upperStart[blockID + 1], -1, vFirst + b, 1 - min<int>((t + 1) * tile, uNum));
+		}
+	}
+	return scanned;
+}
+
+GRIDMAP gridCreation(const int & xMin, const int & xMax, const int & yMin, const int & yMax,
+					 const int & window, const CRITICALNET & criticalNet, LAYER & layer,
+					 const vector<CONDUCTOR> & conductorInfo, LAYERSTAT & stat)
+{
+	STAGETIMER timer (stat.gridCreation.seconds);
+	long long scanned = 0;
 	const int gridWidthNum = (xMax - 1 - xMin) / layer.gridSize() + 1;
 	const int gridHeightNum = (yMax - 1 - yMin) / layer.gridSize() + 1;
-	vector<vector<GRID>> gridInfo (gridWidthNum, vector<GRID> (gridHeightNum));
+	GRIDMAP gridInfo;
+	gridInfo.widthNum = gridWidthNum;
+	gridInfo.heightNum = gridHeightNum;
+	gridInfo.gridSize = layer.gridSize();
+	gridInfo.xMin = xMin;
+	gridInfo.yMin = yMin;
+	gridInfo.cellType.assign(size_t(gridWidthNum) * gridHeightNum, GRIDTYPE::Empty);
+	gridInfo.dummyStart.assign(gridInfo.size() + 1, 0);
 	
+	// The grid is built in column strips. The cells of a strip form one contiguous ID
+	// range, and each strip only writes its own cells, so the strips run concurrently
+	// on the threads left over by the layers in flight. A conductor is handed to every
+	// strip its cells reach, and the strips visit conductors in layer order, so the
+	// result matches a sequential build.
+	const int stripThreads = max<int>(omp_get_max_threads() / omp_get_num_threads(), 1);
+	const int stripWidth = max<int>((gridWidthNum + 4 * stripThreads - 1) / (4 * stripThreads), 1);
+	const int stripNum = (gridWidthNum + stripWidth - 1) / stripWidth;
+	auto stripRange = [&](int first, int last)
+	{
+		first = max<int>(first, 0);
+		last = min<int>(last, gridWidthNum - 1);
+		return first > last ? array<int, 2> {0, -1} : array<int, 2> {first / stripWidth, last / stripWidth};
+	};
+
 	int horizontal = 0, vertical = 0;
 	vector<int> criticalID;
+	vector<int> conductorStrip (stripNum + 1, 0), conductorStripList;
 	for(const int & i : layer.conductorID)
 	{
 		const CONDUCTOR & conductor = conductorInfo[i];
@@ -139,533 +1097,1088 @@ vector<vector<GRID>> gridCreation(const int & xMin, const int & xMax, const int
 		if(criticalNet.netID.find(conductor.netID) != criticalNet.netID.end())
 			criticalID.emplace_back(i);
 
-		const int left = (conductor.left - xMin) / layer.gridSize();
-		const int right = (conductor.right - 1 - xMin) / layer.gridSize();
-		const int bottom= (conductor.bottom - yMin) / layer.gridSize();
-		const int top= (conductor.top - 1 - yMin) / layer.gridSize();
-		for(int x = max<int>(left - 1, 0); (x <= right + 1) && (x < gridWidthNum); x++)
+		const array<int, 2> strip = stripRange((conductor.left - xMin) / layer.gridSize(), (conductor.right - 1 - xMin) / layer.gridSize());
+		for(int s = strip[0]; s <= strip[1]; s++)
+			conductorStrip[s]++;
+	}
+	csrPrefix(conductorStrip, conductorStripList);
+	for(auto iter = layer.conductorID.rbegin(); iter != layer.conductorID.rend(); iter++)
+	{
+		const CONDUCTOR & conductor = conductorInfo[*iter];
+		const array<int, 2> strip = stripRange((conductor.left - xMin) / layer.gridSize(), (conductor.right - 1 - xMin) / layer.gridSize());
+		for(int s = strip[0]; s <= strip[1]; s++)
+			conductorStripList[--conductorStrip[s]] = *iter;
+	}
+
+	// Cells a conductor overlaps, and cells it covers in full; the latter is empty when
+	// the conductor is thinner than a cell
+	auto cellBox = [&](const CONDUCTOR & conductor)
+	{
+		return array<int, 4> {(conductor.left - xMin) / layer.gridSize(), (conductor.bottom - yMin) / layer.gridSize(),
+							  min<int>((conductor.right - 1 - xMin) / layer.gridSize(), gridWidthNum - 1),
+							  min<int>((conductor.top - 1 - yMin) / layer.gridSize(), gridHeightNum - 1)};
+	};
+	auto fullBox = [&](const CONDUCTOR & conductor)
+	{
+		return array<int, 4> {(conductor.left - xMin + layer.gridSize() - 1) / layer.gridSize(),
+							  (conductor.bottom - yMin + layer.gridSize() - 1) / layer.gridSize(),
+							  min<int>((conductor.right - xMin) / layer.gridSize() - 1, gridWidthNum - 1),
+							  min<int>((conductor.top - yMin) / layer.gridSize() - 1, gridHeightNum - 1)};
+	};
+
+	// Cells overlapped by conductors, and cells covered in full by one, flagged a column
+	// at a time with whole words, so the cost follows the conductors' widths rather
+	// than their area. The types are then written from the flags: Conductor cells, and
+	// the one-cell Spacing halo, i.e. the cells next to a Conductor cell, diagonals
+	// included, found by shifting the flags of three neighbouring columns.
+	CELLBITS coverCell (gridWidthNum, gridHeightNum), fullCell (gridWidthNum, gridHeightNum);
+	const int columnWords = coverCell.columnWords;
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(stripThreads) reduction(+ : scanned)
+	for(int s = 0; s < stripNum; s++)
+	{
+		const int stripLeft = s * stripWidth, stripRight = min<int>(stripLeft + stripWidth, gridWidthNum) - 1;
+		auto flag = [&](CELLBITS & bits, const array<int, 4> & box)
 		{
-			for(int y = max<int>(bottom - 1, 0); (y <= top + 1) && (y < gridHeightNum); y++)
+			if(box[1] > box[3])
+				return;
+			for(int x = max<int>(box[0], stripLeft); x <= min<int>(box[2], stripRight); x++)
 			{
-				GRID & nowGrid = gridInfo[x][y];
-				if(x >= left && x <= right && y >= bottom && y <= top)
+				scanned++;
+				setBits(bits.column(x), box[1], box[3]);
+			}
+		};
+		for(int k = conductorStrip[s]; k < conductorStrip[s + 1]; k++)
+		{
+			const CONDUCTOR & conductor = conductorInfo[conductorStripList[k]];
+			flag(coverCell, cellBox(conductor));
+			flag(fullCell, fullBox(conductor));
+		}
+	}
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(stripThreads) reduction(+ : scanned)
+	for(int s = 0; s < stripNum; s++)
+	{
+		const int stripLeft = s * stripWidth, stripRight = min<int>(stripLeft + stripWidth, gridWidthNum) - 1;
+		vector<unsigned long long> across (columnWords + 2, 0);
+		for(int x = stripLeft; x <= stripRight; x++)
+		{
+			const unsigned long long * cover = coverCell.column(x);
+			const unsigned long long * left = coverCell.column(max<int>(x - 1, 0));
+			const unsigned long long * right = coverCell.column(min<int>(x + 1, gridWidthNum - 1));
+			// Rows with a Conductor cell in columns x - 1 to x + 1, padded by a word each side
+			for(int word = 0; word < columnWords; word++)
+				across[word + 1] = left[word] | cover[word] | right[word];
+			unsigned char * cell = gridInfo.cellType.data() + gridInfo.id(x, 0);
+			for(int word = 0; word < columnWords; word++)
+			{
+				const unsigned long long near = across[word + 1] | across[word + 1] << 1 | across[word + 1] >> 1 |
+												across[word] >> 63 | across[word + 2] << 63;
+				unsigned long long spacing = near & ~cover[word] & wordMask(word, 0, gridHeightNum - 1);
+				for(unsigned long long bits = cover[word]; bits; bits &= bits - 1)
+					cell[word * 64 + __builtin_ctzll(bits)] = GRIDTYPE::Conductor;
+				for(; spacing; spacing &= spacing - 1)
+					cell[word * 64 + __builtin_ctzll(spacing)] = GRIDTYPE::Spacing;
+			}
+			scanned += columnWords;
+		}
+	}
+
+	// Conductors of the cells covered in part only. Such cells lie on the rim of a
+	// conductor's cells, outside the cells it covers in full. Each strip hands its
+	// conductors to their columns and lists the rim cells of every column in order with
+	// a counting sort, keeping layer order within a cell.
+	vector<vector<size_t>> stripCell (stripNum);
+	vector<vector<int>> stripStart (stripNum), stripList (stripNum);
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(stripThreads) reduction(+ : scanned)
+	for(int s = 0; s < stripNum; s++)
+	{
+		const int stripLeft = s * stripWidth, stripRight = min<int>(stripLeft + stripWidth, gridWidthNum) - 1;
+		vector<int> columnStart (stripRight - stripLeft + 2, 0), columnList;
+		for(int k = conductorStrip[s]; k < conductorStrip[s + 1]; k++)
+		{
+			const array<int, 4> cell = cellBox(conductorInfo[conductorStripList[k]]);
+			for(int x = max<int>(cell[0], stripLeft); x <= min<int>(cell[2], stripRight); x++)
+				columnStart[x - stripLeft]++;
+		}
+		csrPrefix(columnStart, columnList);
+		for(int k = conductorStrip[s + 1] - 1; k >= conductorStrip[s]; k--)
+		{
+			const array<int, 4> cell = cellBox(conductorInfo[conductorStripList[k]]);
+			for(int x = max<int>(cell[0], stripLeft); x <= min<int>(cell[2], stripRight); x++)
+				columnList[--columnStart[x - stripLeft]] = conductorStripList[k];
+		}
+
+		vector<size_t> & memberCell = stripCell[s];
+		vector<int> & memberStart = stripStart[s], & memberList = stripList[s];
+		// Conductors of each rim cell of the column, then where they go in memberList
+		vector<int> count (gridHeightNum, 0);
+		vector<unsigned long long> rim (columnWords, 0);
+		for(int x = stripLeft; x <= stripRight; x++)
+		{
+			auto rimCells = [&](bool place)
+			{
+				for(int k = columnStart[x - stripLeft]; k < columnStart[x - stripLeft + 1]; k++)
 				{
-					nowGrid.type = GRIDTYPE::Conductor;
-					nowGrid.conductorID.emplace_back(i);
+					const array<int, 4> cell = cellBox(conductorInfo[columnList[k]]), full = fullBox(conductorInfo[columnList[k]]);
+					const bool inner = full[1] <= full[3] && x >= full[0] && x <= full[2];
+					for(int y = cell[1]; y <= cell[3]; y++)
+					{
+						if(inner && y == full[1])
+						{
+							y = full[3];
+							continue;
+						}
+						if(fullCell.test(x, y))
+							continue;
+						if(place)
+							memberList[count[y]++] = columnList[k];
+						else
+						{
+							scanned++;
+							count[y]++;
+							rim[y / 64] |= 1ULL << (y % 64);
+						}
+					}
 				}
-				else
+			};
+			rimCells(false);
+			const size_t columnFirst = memberCell.size();
+			int total = int(memberList.size());
+			for(int word = 0; word < columnWords; word++)
+			{
+				for(; rim[word]; rim[word] &= rim[word] - 1)
 				{
-					if(nowGrid.type < GRIDTYPE::Spacing)
-						nowGrid.type = GRIDTYPE::Spacing;
+					const int y = word * 64 + __builtin_ctzll(rim[word]);
+					memberCell.emplace_back(gridInfo.id(x, y));
+					memberStart.emplace_back(total);
+					swap(count[y], total);
+					total += count[y];
 				}
 			}
+			memberList.resize(total);
+			rimCells(true);
+			for(size_t i = columnFirst; i < memberCell.size(); i++)
+				count[memberCell[i] - gridInfo.id(x, 0)] = 0;
 		}
+		scanned += stripRight - stripLeft + 1;
+	}
+	for(int s = 0; s < stripNum; s++)
+	{
+		const int offset = int(gridInfo.conductorList.size());
+		gridInfo.conductorCell.insert(gridInfo.conductorCell.end(), stripCell[s].begin(), stripCell[s].end());
+		for(const int & start : stripStart[s])
+			gridInfo.conductorStart.emplace_back(offset + start);
+		gridInfo.conductorList.insert(gridInfo.conductorList.end(), stripList[s].begin(), stripList[s].end());
 	}
+	gridInfo.conductorStart.emplace_back(int(gridInfo.conductorList.size()));
+
+	gridInfo.conductorIndex.build(conductorInfo, layer.conductorID, xMin, yMin, xMax, yMax, window / WINDOW_MOVING_STEP);
 
 	if(horizontal >= vertical)
 		layer.direction = DIRECTION::Horizontal;
 	else
 		layer.direction = DIRECTION::Vertical;
 
+	// Critical cells: Empty cells within SAFE_SPACING of a critical conductor, walked
+	// outwards along rows and columns until a wall of conductors blocks the way. Both
+	// passes only read the conductor cells flagged above and only turn Empty into
+	// Critical, so they do not depend on each other.
+	vector<array<int, 8>> critical;
+	critical.reserve(criticalID.size());
 	for(const int & i : criticalID)
 	{
 		const CONDUCTOR & conductor = conductorInfo[i];
-
-		const int left = (conductor.left - xMin) / layer.gridSize();
-		const int right = (conductor.right - 1 - xMin) / layer.gridSize();
-		const int bottom= (conductor.bottom - yMin) / layer.gridSize();
-		const int top= (conductor.top - 1 - yMin) / layer.gridSize();
-
-		const int cLeft = max<int>((conductor.left - SAFE_SPACING -xMin) / layer.gridSize(), 0);
-		const int cRight = min<int>((conductor.right - 1 + SAFE_SPACING - xMin) / layer.gridSize(), gridWidthNum - 1);
-		const int cBottom= max<int>((conductor.bottom - SAFE_SPACING -yMin) / layer.gridSize(), 0);
-		const int cTop= min<int>((conductor.top - 1 + SAFE_SPACING - yMin) / layer.gridSize(), gridHeightNum - 1);
-		
-		for(int y = bottom; y <= top; y++)
-		{
-			for(int x = max<int>(left - 2, 0); x >= cLeft; x--)
-			{
-				GRID & nowGrid = gridInfo[x][y];
-				if(nowGrid.type == GRIDTYPE::Conductor &&
-				   gridInfo[x][max<int>(y - 1, 0)].type == GRIDTYPE::Conductor &&
-				   gridInfo[x][min<int>(y + 1, gridHeightNum - 1)].type == GRIDTYPE::Conductor)
-					break;
-				if(nowGrid.type == GRIDTYPE::Empty)
-					nowGrid.type = GRIDTYPE::Critical;
-			}
-			for(int x = min<int>(right + 2, gridWidthNum - 1); x <= cRight; x++)
-			{
-				GRID & nowGrid = gridInfo[x][y];
-				if(nowGrid.type == GRIDTYPE::Conductor &&
-				   gridInfo[x][max<int>(y - 1, 0)].type == GRIDTYPE::Conductor &&
-				   gridInfo[x][min<int>(y + 1, gridHeightNum - 1)].type == GRIDTYPE::Conductor)
-					break;
-				if(nowGrid.type == GRIDTYPE::Empty)
-					nowGrid.type = GRIDTYPE::Critical;
-			}
-		}
-
-		for(int x = left; x <= right; x++)
-		{
-			for(int y = max<int>(bottom - 2, 0); y >= cBottom; y--)
-			{
-				GRID & nowGrid = gridInfo[x][y];
-				if(nowGrid.type == GRIDTYPE::Conductor &&
-				   gridInfo[max<int>(x - 1, 0)][y].type == GRIDTYPE::Conductor &&
-				   gridInfo[min<int>(x + 1, gridWidthNum - 1)][y].type == GRIDTYPE::Conductor)
-					break;
-				if(nowGrid.type == GRIDTYPE::Empty)
-					nowGrid.type = GRIDTYPE::Critical;
-			}
-			for(int y = min<int>(top + 2, gridHeightNum - 1); y <= cTop; y++)
-			{
-				GRID & nowGrid = gridInfo[x][y];
-				if(nowGrid.type == GRIDTYPE::Conductor &&
-				   gridInfo[max<int>(x - 1, 0)][y].type == GRIDTYPE::Conductor &&
-				   gridInfo[min<int>(x + 1, gridWidthNum - 1)][y].type == GRIDTYPE::Conductor)
-					break;
-				if(nowGrid.type == GRIDTYPE::Empty)
-					nowGrid.type = GRIDTYPE::Critical;
-			}
-		}
+		critical.emplace_back(array<int, 8> {(conductor.left - xMin) / layer.gridSize(),
+											 (conductor.bottom - yMin) / layer.gridSize(),
+											 (conductor.right - 1 - xMin) / layer.gridSize(),
+											 (conductor.top - 1 - yMin) / layer.gridSize(),
+											 max<int>((conductor.left - SAFE_SPACING -xMin) / layer.gridSize(), 0),
+											 max<int>((conductor.bottom - SAFE_SPACING -yMin) / layer.gridSize(), 0),
+											 min<int>((conductor.right - 1 + SAFE_SPACING - xMin) / layer.gridSize(), gridWidthNum - 1),
+											 min<int>((conductor.top - 1 + SAFE_SPACING - yMin) / layer.gridSize(), gridHeightNum - 1)});
 	}
+	scanned += criticalPass(GRIDVIEW<DIRECTION::Horizontal> {gridInfo}, coverCell, critical, stripThreads);
+	scanned += criticalPass(GRIDVIEW<DIRECTION::Vertical> {gridInfo}, coverCell, critical, stripThreads);
 
 	const int smallWindow = window / WINDOW_MOVING_STEP;
+	gridInfo.xSeperate.assign(gridWidthNum, -1);
+	gridInfo.ySeperate.assign(gridHeightNum, -1);
+	gridInfo.xDensitySeperate.assign(gridWidthNum, false);
+	gridInfo.yDensitySeperate.assign(gridHeightNum, false);
 	int xWindow = 1, yWindow = 1;
 	for(int x = 0; x < gridWidthNum; x++)
 	{
-		bool xDensitySeperate = false, xReserveSpacing = false;
-		int xSeperate;
 		if((x + 1) * layer.gridSize() >= xWindow * smallWindow)
 		{
-			xDensitySeperate = true;
-			xSeperate = xMin + xWindow * smallWindow;
+			gridInfo.xDensitySeperate[x] = true;
+			gridInfo.xSeperate[x] = xMin + xWindow * smallWindow;
 			xWindow++;
 		}
-
-		yWindow = 1;
-		for(int y = 0; y < gridHeightNum; y++)
+	}
+	for(int y = 0; y < gridHeightNum; y++)
+	{
+		if((y + 1) * layer.gridSize() >= yWindow * smallWindow)
 		{
-			GRID & nowGrid = gridInfo[x][y];
-			nowGrid.x = xMin + x * layer.gridSize();
-			nowGrid.y = yMin + y * layer.gridSize();
-			if(xDensitySeperate)
-			{
-				nowGrid.xDensitySeperate = true;
-				nowGrid.xSeperate = xSeperate;
-				nowGrid.density[1][0] = 0;
-			}
-			if((y + 1) * layer.gridSize() >= yWindow * smallWindow)
-			{
-				int ySeperate = yMin + yWindow * smallWindow;
-				nowGrid.yDensitySeperate = true;
-				nowGrid.ySeperate = ySeperate;
-				nowGrid.density[0][1] = 0;
-				if(xDensitySeperate)
-					nowGrid.density[1][1] = 0;
-				yWindow++;
-			}
+			gridInfo.yDensitySeperate[y] = true;
+			gridInfo.ySeperate[y] = yMin + yWindow * smallWindow;
+			yWindow++;
 		}
 	}
 
+	stat.gridWidthNum = gridWidthNum;
+	stat.gridHeightNum = gridHeightNum;
+	stat.gridCreation.cellsScanned = scanned;
 	return gridInfo;
 }
 
-void dummyInsertion(vector<DUMMY> & dummyInfo, const int & xMax, const int & yMax,
-					vector<vector<GRID>> & gridInfo, LAYER & layer,
-					const vector<CONDUCTOR> & conductorInfo)
+// Greedy fill of dummyInsertion along the tracks of the layer. Free cells wait in a
+// queue ordered by track (lowest v first); each one grows a dummy of up to maxWidth
+// along and across the tracks over cells of its own type, Empty ones giving inserted
+// dummies and Critical ones Reserved dummies, and rings it with Spacing cells. The grid
+// boxes of the dummies appended to dummyInfo are added to dummyCell. Only the lines
+// [uBegin, uEnd) are read or written: dummies stop at uEnd and their rings skip the
+// lines outside.
+template<DIRECTION D>
+void insertionKernel(GRIDVIEW<D> view, const int & uBegin, const int & uEnd, vector<DUMMY> & dummyInfo,
+					 const int & xMax, const int & yMax, const LAYER & layer, vector<array<int, 4>> & dummyCell,
+					 LAYERSTAT & stat, long long & scanned)
 {
-	class insertOrderCompare
+	struct trackOrder
+	{
+		bool operator() (const array<int, 2> & lhs, const array<int, 2> & rhs) const { return lhs[1] > rhs[1]; }
+	};
+	priority_queue<array<int, 2>, vector<array<int, 2>>, trackOrder> insertOrder;
+	const int vNum = view.vNum();
+	const int maxCell = layer.maxWidth / layer.gridSize();
+
+	// Every cell a dummy covers or rings is cleared below, as it stops being Empty or Critical
+	const GRIDMAP & grid = view.grid;
+	FREEMAP freeCell (uEnd - uBegin, vNum, grid.cellType.data() + view.id(uBegin, 0), view.id(1, 0) - view.id(0, 0), view.id(0, 1) - view.id(0, 0));
+	// Queues the first free cell of line u from v = vStart on, stopping short of the
+	// track of the queue front
+	auto queueFree = [&](int u, int vStart)
 	{
-		DIRECTION direction;
-	public:
-		insertOrderCompare(const DIRECTION & dir) { direction = dir ;}
-		bool operator() (const array<int, 2> & lhs, const array<int, 2> & rhs)
+		scanned++;
+		const int v = freeCell.next(u - uBegin, vStart, (insertOrder.empty() ? vNum : insertOrder.top()[1]) - 1);
+		if(v < 0)
+			return false;
+		insertOrder.push(array<int, 2> {u, v});
+		stat.queuePushes++;
+		return true;
+	};
+	// Does so line by line from u = uStart until the queue front is on track vStart
+	auto findNext = [&](int uStart, int vStart)
+	{
+		for(int u = uStart; u < uEnd; u++)
 		{
-			if(direction == DIRECTION::Horizontal)
-				return lhs[1] > rhs[1];
-			else if(direction == DIRECTION::Vertical)
-				return lhs[0] > rhs[0];
+			queueFree(u, vStart);
+			if(!insertOrder.empty() && insertOrder.top()[1] == vStart)
+				break;
 		}
 	};
-	priority_queue<array<int, 2>, vector<array<int, 2>>, insertOrderCompare> insertOrder(insertOrderCompare(layer.direction));
 
-	auto findNext = [&](int xStart, int yStart) 
-    {
-		if(layer.direction == DIRECTION::Horizontal)
+	findNext(uBegin, 0);
+	while(!insertOrder.empty())
+	{
+		const array<int, 2> coordinate = insertOrder.top();
+		insertOrder.pop();
+		stat.queuePops++;
+		const int u0 = coordinate[0], v0 = coordinate[1];
+		if(!freeCell.test(u0 - uBegin, v0))
+		{
+			findNext(u0, v0);
+			continue;
+		}
+
+		const GRIDTYPE nowType = view.type(u0, v0);
+		int along, across = maxCell, across2 = maxCell;
+		GRIDTYPE acrossType = nowType, acrossType2 = nowType;
+		bool same = false;
+		for(along = 0; along < maxCell && u0 + along < uEnd; along++)
 		{
-			for(int x = xStart; x < gridInfo.size(); x++)
+			if(view.type(u0 + along, v0) != nowType)
 			{
-				for(int y = yStart; (insertOrder.empty() && y < gridInfo[0].size()) || (!insertOrder.empty() && y < insertOrder.top()[1]); y++)
+				if(nowType == GRIDTYPE::Critical)
 				{
-					if(gridInfo[x][y].type == GRIDTYPE::Empty || gridInfo[x][y].type == GRIDTYPE::Critical)
+					if(view.type(u0 + along, v0) == GRIDTYPE::Empty)
 					{
-						insertOrder.push(array<int, 2> {x, y});
-						break;
+						along--;
+						if(same)
+						{
+							across = across2;
+							acrossType = acrossType2;
+						}
 					}
+					if(acrossType == GRIDTYPE::Empty)
+						across--;
 				}
-				if(!insertOrder.empty() && insertOrder.top()[1] == yStart)
-					break;
+				break;
 			}
-		}
-		else if(layer.direction == DIRECTION::Vertical)
-		{
-			for(int y = yStart; y < gridInfo[0].size(); y++)
+			same = false;
+			for(int vMove = 1; vMove < across && v0 + vMove < vNum; vMove++)
 			{
-				for(int x = xStart; (insertOrder.empty() && x < gridInfo.size()) || (!insertOrder.empty() && x < insertOrder.top()[0]); x++)
+				if(view.type(u0 + along, v0 + vMove) != nowType)
 				{
-					if(gridInfo[x][y].type == GRIDTYPE::Empty || gridInfo[x][y].type == GRIDTYPE::Critical)
+					if(along == 0)
 					{
-						insertOrder.push(array<int, 2> {x, y});
-						break;
+						across2 = vMove;
+						acrossType2 = view.type(u0 + along, v0 + vMove);
+					}
+					else
+					{
+						across2 = across;
+						acrossType2 = acrossType;
 					}
+					across = vMove;
+					acrossType = view.type(u0 + along, v0 + vMove);
+					same = true;
 				}
-				if(!insertOrder.empty() && insertOrder.top()[0] == xStart)
-					break;
 			}
 		}
-    };
-	
-	if(layer.direction == DIRECTION::Horizontal)
-	{
-		if(insertOrder.empty())
-			findNext(0, 0);
 
-		while(!insertOrder.empty())
+		const array<int, 2> low = GRIDVIEW<D>::swap(u0, v0), size = GRIDVIEW<D>::swap(along, across);
+		DUMMY newDummy = {.inserted = (nowType == GRIDTYPE::Empty),
+						  .dummyID = int(dummyInfo.size()),
+						  .left = grid.x(low[0]),
+						  .bottom = grid.y(low[1]),
+						  .right = min<int>(grid.x(low[0]) + size[0] * layer.gridSize(), xMax),
+						  .top = min<int>(grid.y(low[1]) + size[1] * layer.gridSize(), yMax),
+						  .layerID = layer.layerID};
+		if(newDummy.right - newDummy.left < layer.minWidth || newDummy.top - newDummy.bottom < layer.minWidth)
 		{
-			array<int, 2> coordinate = insertOrder.top();
-			insertOrder.pop();
-			if(gridInfo[coordinate[0]][coordinate[1]].type != GRIDTYPE::Empty && gridInfo[coordinate[0]][coordinate[1]].type != GRIDTYPE::Critical)
-				findNext(coordinate[0], coordinate[1]);
-			else
+			findNext(u0, v0 + 1);
+			findNext(u0 + 1, v0);
+			continue;
+		}
+
+		dummyInfo.emplace_back(newDummy);
+		stat.dummiesCreated++;
+		stat.dummiesReserved += !newDummy.inserted;
+		dummyCell.emplace_back(array<int, 4> {low[0], low[1], min<int>(low[0] + size[0], grid.widthNum), min<int>(low[1] + size[1], grid.heightNum)});
+		for(int u = max<int>(u0 - 1, uBegin); u <= u0 + along && u < uEnd; u++)
+		{
+			for(int v = v0; v <= v0 + across && v < vNum; v++)
 			{
-				const GRIDTYPE nowType = gridInfo[coordinate[0]][coordinate[1]].type;
-				int width, height = layer.maxWidth / layer.gridSize(), height2 = layer.maxWidth / layer.gridSize();
-				GRIDTYPE yType = nowType, yType2 = nowType;
-				bool same = false;
-				for(width = 0; width < layer.maxWidth / layer.gridSize() && coordinate[0] + width < gridInfo.size(); width++)
+				unsigned char & nowCell = view.cell(u, v);
+				if(u >= u0 && u < u0 + along && v >= v0 && v < v0 + across)
 				{
-					if(gridInfo[coordinate[0] + width][coordinate[1]].type != nowType)
-					{
-						if(nowType == GRIDTYPE::Critical)
-						{
-							if(gridInfo[coordinate[0] + width][coordinate[1]].type == GRIDTYPE::Empty)
-							{
-								width--;
-								if(same)
-								{
-									height = height2;
-									yType = yType2;
-								}
-							}
-							if(yType == GRIDTYPE::Empty)
-								height--;
-						}
-						break;
-					}
-					same = false;
-					for(int yMove = 1; yMove < height && coordinate[1] + yMove < gridInfo[0].size(); yMove++)
-					{
-						if(gridInfo[coordinate[0] + width][coordinate[1] + yMove].type != nowType)
-						{
-							if(width == 0)
-							{
-								height2 = yMove;
-								yType2 = gridInfo[coordinate[0] + width][coordinate[1] + yMove].type;
-							}
-							else
-							{
-								height2 = height;
-								yType2 = yType;
-							}
-							height = yMove;
-							yType = gridInfo[coordinate[0] + width][coordinate[1] + yMove].type;
-							same = true;
-						}
-					}
+					if(nowCell == GRIDTYPE::Empty)
+						nowCell = GRIDTYPE::Dummy;
+					else if(nowCell == GRIDTYPE::Critical)
+						nowCell = GRIDTYPE::Reserved;
+					view.grid.dummyStart[view.id(u, v)]++;
 				}
+				else
+					nowCell = GRIDTYPE::Spacing;
+			}
+			freeCell.clear(u - uBegin, v0, min<int>(v0 + across, vNum - 1));
+			queueFree(u, v0 + across + 1);
+		}
 
-				DUMMY newDummy = {.inserted = (nowType == GRIDTYPE::Empty),
-								  .dummyID = int(dummyInfo.size()),
-								  .left = gridInfo[coordinate[0]][coordinate[1]].x,
-								  .bottom = gridInfo[coordinate[0]][coordinate[1]].y,
-								  .right = min<int>(gridInfo[coordinate[0]][coordinate[1]].x + width * layer.gridSize(), xMax),
-								  .top = min<int>(gridInfo[coordinate[0]][coordinate[1]].y + height * layer.gridSize(), yMax),
-								  .layerID = layer.layerID};
-				if(newDummy.right - newDummy.left < layer.minWidth || newDummy.top - newDummy.bottom < layer.minWidth)
-				{
-					findNext(coordinate[0], coordinate[1] + 1);
-					findNext(coordinate[0] + 1, coordinate[1]);
-					continue;
-				}
-				
-				// cout << " E "; cout.flush();
-				dummyInfo.emplace_back(newDummy);
-				for(int x = max<int>(coordinate[0] - 1, 0); x <= coordinate[0] + width && x < gridInfo.size(); x++)
-				{
-					for(int y = coordinate[1]; y <= coordinate[1] + height && y < gridInfo[0].size(); y++)
-					{
-						GRID & nowGrid = gridInfo[x][y];
-						if(x >= coordinate[0] && x < coordinate[0] + width && y >= coordinate[1] && y < coordinate[1] + height)
-						{
-							if(nowGrid.type == GRIDTYPE::Empty)
-								nowGrid.type = GRIDTYPE::Dummy;
-							else if(nowGrid.type == GRIDTYPE::Critical)
-								nowGrid.type = GRIDTYPE::Reserved;
-							nowGrid.dummyID.emplace_back(newDummy.dummyID);
-						}
-						else
-							nowGrid.type = GRIDTYPE::Spacing;
-					}
+		findNext(u0 + along + 1, v0);
+	}
+}
 
-					for(int y = coordinate[1] + height + 1; (insertOrder.empty() && y < gridInfo[0].size()) || (!insertOrder.empty() && y < insertOrder.top()[1]); y++)
-					{
-						if(gridInfo[x][y].type == GRIDTYPE::Empty || gridInfo[x][y].type == GRIDTYPE::Critical)
-						{
-							insertOrder.push(array<int, 2> {x, y});
-							break;
-						}
-					}
-				}
+// dummyInsertion over strips of lines (along the tracks). Strip s fills its lines up
+// to the one before the next strip, the seam, which no strip reads or writes, so the
+// strips run in parallel. A strip holds more than maxWidth lines, so no dummy reaches
+// from one seam to the next. Each seam is then stitched in order: dummies facing each
+// other across it with the same tracks and type are merged through it when the seam
+// cells between them are free and of that type and the result is no longer than
+// maxWidth; every other dummy ending on the seam gets its ring written on it. The
+// result only depends on the number of strips; one strip is the plain kernel.
+template<DIRECTION D>
+void stripInsertion(GRIDVIEW<D> view, const int & strips, vector<DUMMY> & dummyInfo, const int & xMax, const int & yMax,
+					const LAYER & layer, vector<array<int, 4>> & dummyCell, LAYERSTAT & stat, long long & scanned)
+{
+	const int uNum = view.uNum(), vNum = view.vNum();
+	const int maxCell = layer.maxWidth / layer.gridSize();
+	const int stripNum = max<int>(min<int>(strips, uNum / (maxCell + 2)), 1);
+	vector<int> stripBegin (stripNum + 1);
+	for(int s = 0; s <= stripNum; s++)
+		stripBegin[s] = int((long long)(uNum) * s / stripNum);
+	auto stripEnd = [&](int s) { return s + 1 < stripNum ? stripBegin[s + 1] - 1 : uNum; };
+
+	vector<vector<DUMMY>> stripDummy (stripNum);
+	vector<vector<array<int, 4>>> stripCell (stripNum);
+	vector<LAYERSTAT> stripStat (stripNum);
+	vector<long long> stripScanned (stripNum, 0);
+	const int threads = max<int>(omp_get_max_threads() / omp_get_num_threads(), 1);
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(min<int>(threads, stripNum))
+	for(int s = 0; s < stripNum; s++)
+		insertionKernel(view, stripBegin[s], stripEnd(s), stripDummy[s], xMax, yMax, layer, stripCell[s], stripStat[s], stripScanned[s]);
+	stat.insertionStrips = stripNum;
+	for(int s = 0; s < stripNum; s++)
+	{
+		addStat(stat, stripStat[s]);
+		scanned += stripScanned[s];
+	}
+
+	// Box {u0, v0, u1, v1} of a dummy in the view, from its grid box
+	auto viewBox = [&](const array<int, 4> & cell)
+	{
+		const array<int, 2> low = GRIDVIEW<D>::swap(cell[0], cell[1]), high = GRIDVIEW<D>::swap(cell[2], cell[3]);
+		return array<int, 4> {low[0], low[1], high[0], high[1]};
+	};
+	auto ring = [&](int u, const array<int, 4> & box)
+	{
+		for(int v = box[1]; v <= box[3] && v < vNum; v++)
+			view.cell(u, v) = GRIDTYPE::Spacing;
+	};
+	vector<vector<char>> removed (stripNum);
+	for(int s = 0; s < stripNum; s++)
+		removed[s].assign(stripDummy[s].size(), false);
+	for(int s = 0; s + 1 < stripNum; s++)
+	{
+		const int seam = stripBegin[s + 1] - 1;
+		scanned += vNum;
+		// Dummies ending right below the seam and starting right above it, by track
+		vector<array<int, 2>> below, above;
+		for(int i = 0; i < int(stripCell[s].size()); i++)
+		{
+			const array<int, 4> box = viewBox(stripCell[s][i]);
+			if(box[2] == seam)
+				below.emplace_back(array<int, 2> {box[1], i});
+		}
+		for(int i = 0; i < int(stripCell[s + 1].size()); i++)
+		{
+			const array<int, 4> box = viewBox(stripCell[s + 1][i]);
+			if(box[0] == seam + 1)
+				above.emplace_back(array<int, 2> {box[1], i});
+		}
+		sort(below.begin(), below.end());
+		sort(above.begin(), above.end());
+
+		vector<array<int, 2>> pair;
+		vector<char> belowPaired (below.size(), false), abovePaired (above.size(), false);
+		for(size_t i = 0, j = 0; i < below.size() && j < above.size(); )
+		{
+			if(below[i][0] != above[j][0])
+			{
+				(below[i][0] < above[j][0]) ? i++ : j++;
+				continue;
+			}
+			const array<int, 4> low = viewBox(stripCell[s][below[i][1]]), high = viewBox(stripCell[s + 1][above[j][1]]);
+			if(low[3] == high[3] && stripDummy[s][below[i][1]].inserted == stripDummy[s + 1][above[j][1]].inserted &&
+			   high[2] - low[0] <= maxCell)
+			{
+				pair.emplace_back(array<int, 2> {below[i][1], above[j][1]});
+				belowPaired[i] = abovePaired[j] = true;
+			}
+			i++;
+			j++;
+		}
+		for(size_t i = 0; i < below.size(); i++)
+			if(!belowPaired[i])
+				ring(seam, viewBox(stripCell[s][below[i][1]]));
+		for(size_t j = 0; j < above.size(); j++)
+			if(!abovePaired[j])
+				ring(seam, viewBox(stripCell[s + 1][above[j][1]]));
+
+		for(const array<int, 2> & p : pair)
+		{
+			DUMMY & lower = stripDummy[s][p[0]];
+			const array<int, 4> low = viewBox(stripCell[s][p[0]]), high = viewBox(stripCell[s + 1][p[1]]);
+			const GRIDTYPE freeType = lower.inserted ? GRIDTYPE::Empty : GRIDTYPE::Critical;
+			bool free = true;
+			for(int v = low[1]; v < low[3] && free; v++)
+				free = view.type(seam, v) == freeType;
+			if(!free)
+			{
+				ring(seam, low);
+				ring(seam, high);
+				continue;
+			}
 
-				findNext(coordinate[0] + width + 1, coordinate[1]);
+			for(int v = low[1]; v < low[3]; v++)
+			{
+				view.cell(seam, v) = lower.inserted ? GRIDTYPE::Dummy : GRIDTYPE::Reserved;
+				view.grid.dummyStart[view.id(seam, v)]++;
 			}
+			if(low[3] < vNum)
+				view.cell(seam, low[3]) = GRIDTYPE::Spacing;
+			const array<int, 2> first = GRIDVIEW<D>::swap(low[0], low[1]), last = GRIDVIEW<D>::swap(high[2], high[3]);
+			const array<int, 2> size = GRIDVIEW<D>::swap(high[2] - low[0], low[3] - low[1]);
+			lower.right = min<int>(view.grid.x(first[0]) + size[0] * layer.gridSize(), xMax);
+			lower.top = min<int>(view.grid.y(first[1]) + size[1] * layer.gridSize(), yMax);
+			stripCell[s][p[0]] = array<int, 4> {first[0], first[1], last[0], last[1]};
+			removed[s + 1][p[1]] = true;
+			stat.seamMerges++;
+			stat.dummiesCreated--;
+			stat.dummiesReserved -= !lower.inserted;
 		}
 	}
-	else if(layer.direction == DIRECTION::Vertical)
+
+	for(int s = 0; s < stripNum; s++)
 	{
-		if(insertOrder.empty())
-			findNext(0, 0);
-		
-		while(!insertOrder.empty())
+		for(size_t i = 0; i < stripDummy[s].size(); i++)
 		{
-			array<int, 2> coordinate = insertOrder.top();
-			insertOrder.pop();
-			
-			if(gridInfo[coordinate[0]][coordinate[1]].type != GRIDTYPE::Empty && gridInfo[coordinate[0]][coordinate[1]].type != GRIDTYPE::Critical)
-				findNext(coordinate[0], coordinate[1]);
-			else
+			if(removed[s][i])
+				continue;
+			stripDummy[s][i].dummyID = int(dummyInfo.size());
+			dummyInfo.emplace_back(stripDummy[s][i]);
+			dummyCell.emplace_back(stripCell[s][i]);
+		}
+	}
+}
+
+void dummyInsertion(vector<DUMMY> & dummyInfo, const int & xMax, const int & yMax,
+					GRIDMAP & gridInfo, LAYER & layer,
+					const vector<CONDUCTOR> & conductorInfo, LAYERSTAT & stat, const int & strips)
+{
+	STAGETIMER timer (stat.dummyInsertion.seconds);
+	long long scanned = 0;
+	// Cell box [left, right) x [bottom, top) of every inserted dummy, turned into the CSR dummy lists at the end
+	vector<array<int, 4>> dummyCell;
+	if(layer.direction == DIRECTION::Horizontal)
+		stripInsertion(GRIDVIEW<DIRECTION::Horizontal> {gridInfo}, strips, dummyInfo, xMax, yMax, layer, dummyCell, stat, scanned);
+	else
+		stripInsertion(GRIDVIEW<DIRECTION::Vertical> {gridInfo}, strips, dummyInfo, xMax, yMax, layer, dummyCell, stat, scanned);
+
+	stat.dummyInsertion.cellsScanned = scanned;
+
+	csrPrefix(gridInfo.dummyStart, gridInfo.dummyList);
+	const int firstDummy = int(dummyInfo.size() - dummyCell.size());
+	for(int i = int(dummyCell.size()) - 1; i >= 0; i--)
+	{
+		for(int x = dummyCell[i][0]; x < dummyCell[i][2]; x++)
+			for(int y = dummyCell[i][1]; y < dummyCell[i][3]; y++)
+				gridInfo.dummyList[--gridInfo.dummyStart[gridInfo.id(x, y)]] = dummyInfo[firstDummy + i].dummyID;
+	}
+
+	vector<int> placed (dummyCell.size());
+	for(size_t i = 0; i < placed.size(); i++)
+		placed[i] = firstDummy + int(i);
+	gridInfo.dummyIndex.build(dummyInfo, placed, gridInfo.xMin, gridInfo.yMin, xMax, yMax,
+							  max<int>(gridInfo.conductorIndex.bucket(), gridInfo.gridSize));
+}
+
+// Splits the deficient small windows into the boxes the fill stage works on. Starting
+// from the first remaining window (rows first for horizontal layers, columns first for
+// vertical ones), a box grows by one row or column whenever a remaining window touches
+// one of its sides, until none does; the windows it covers are then dropped. The boxes
+// are returned in the order they are found and are filled independently of each other.
+vector<array<int, 4>> regionExtraction(DEFICITMAP & needed, const DIRECTION & direction, long long & cellsScanned)
+{
+	vector<array<int, 4>> regions;
+	const bool byRow = direction == DIRECTION::Horizontal;
+	int x = 0, y = 0;
+	while(needed.next(x, y, byRow))
+	{
+		array<int, 4> region {x, y, x, y};
+		bool grown = true;
+		while(grown)
+		{
+			grown = false;
+			if(region[0] > 0 && needed.columnAny(region[0] - 1, region[1], region[3]))
+				region[0]--, grown = true;
+			if(region[2] < needed.width() - 1 && needed.columnAny(region[2] + 1, region[1], region[3]))
+				region[2]++, grown = true;
+			if(region[1] > 0 && needed.rowAny(region[1] - 1, region[0], region[2]))
+				region[1]--, grown = true;
+			if(region[3] < needed.height() - 1 && needed.rowAny(region[3] + 1, region[0], region[2]))
+				region[3]++, grown = true;
+			cellsScanned += 2 * (region[2] - region[0] + region[3] - region[1] + 2);
+		}
+		needed.clear(region);
+		regions.emplace_back(region);
+	}
+	return regions;
+}
+
+// Monotonic allocator for scratch that dies all at once. Allocations bump through
+// chunks and are only given back by reset(), which folds the chunks of the round into
+// one, so a repeated working set soon runs in a single chunk without reaching malloc.
+class ARENA
+{
+	vector<unique_ptr<char[]>> chunk;
+	vector<size_t> chunkSize;
+	size_t used = 0, total = 0;
+public:
+	void * allocate(size_t bytes, size_t align)
+	{
+		size_t offset = (used + align - 1) & ~(align - 1);
+		if(chunk.empty() || offset + bytes > chunkSize.back())
+		{
+			// new[] aligns for every fundamental type
+			const size_t size = max<size_t>(bytes, chunk.empty() ? 1 << 18 : 2 * chunkSize.back());
+			chunk.emplace_back(new char[size]);
+			chunkSize.emplace_back(size);
+			total += size;
+			offset = 0;
+		}
+		used = offset + bytes;
+		return chunk.back().get() + offset;
+	}
+	void reset()
+	{
+		if(chunk.size() > 1)
+		{
+			chunk.clear();
+			chunkSize.clear();
+			chunk.emplace_back(new char[total]);
+			chunkSize.emplace_back(total);
+		}
+		used = 0;
+	}
+};
+
+template<typename T>
+struct ARENAALLOCATOR
+{
+	typedef T value_type;
+	ARENA * arena;
+
+	ARENAALLOCATOR(ARENA & arena) : arena(&arena) {}
+	template<typename U>
+	ARENAALLOCATOR(const ARENAALLOCATOR<U> & other) : arena(other.arena) {}
+	T * allocate(size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T))); }
+	void deallocate(T *, size_t) {}
+	template<typename U>
+	bool operator==(const ARENAALLOCATOR<U> & other) const { return arena == other.arena; }
+	template<typename U>
+	bool operator!=(const ARENAALLOCATOR<U> & other) const { return arena != other.arena; }
+};
+
+template<typename T>
+using ARENAVECTOR = vector<T, ARENAALLOCATOR<T>>;
+
+// A conductor or dummy of a fill region, clipped to the region and projected on the
+// routing direction: "along" runs with the tracks (x on horizontal layers) and "across"
+// between them. The unclipped across extent decides whether two shapes face each other.
+struct REGIONSHAPE
+{
+	int alongLow, alongHigh, acrossLow, acrossHigh;
+	int originalAcrossLow, originalAcrossHigh;
+	bool dummy, merged;
+	int id;
+};
+
+template<DIRECTION D, typename SHAPE>
+REGIONSHAPE regionShape(const SHAPE & shape, const array<int, 4> & box, bool dummy, int id)
+{
+	const int left = max<int>(shape.left, box[0]), bottom = max<int>(shape.bottom, box[1]);
+	const int right = min<int>(shape.right, box[2]), top = min<int>(shape.top, box[3]);
+	if(D == DIRECTION::Horizontal)
+		return REGIONSHAPE {left, right, bottom, top, shape.bottom, shape.top, dummy, false, id};
+	else
+		return REGIONSHAPE {bottom, top, left, right, shape.left, shape.right, dummy, false, id};
+}
+
+// Active spans [low, high) keyed by low, with a max segment tree over high, so that the
+// spans overlapping a query are reported in O((k + 1) log n).
+class SPANINDEX
+{
+	ARENAVECTOR<int> low, order, position, maxHigh;
+	int leafNum = 1;
+
+	void collect(int node, int first, int last, int limit, int queryLow, ARENAVECTOR<int> & found) const
+	{
+		if(first >= limit || maxHigh[node] <= queryLow)
+			return;
+		if(node >= leafNum)
+		{
+			found.emplace_back(order[node - leafNum]);
+			return;
+		}
+		const int middle = (first + last) / 2;
+		collect(2 * node, first, middle, limit, queryLow, found);
+		collect(2 * node + 1, middle + 1, last, limit, queryLow, found);
+	}
+	void set(int id, int high)
+	{
+		int node = leafNum + position[id];
+		maxHigh[node] = high;
+		for(node /= 2; node >= 1; node /= 2)
+			maxHigh[node] = max<int>(maxHigh[2 * node], maxHigh[2 * node + 1]);
+	}
+public:
+	SPANINDEX(const ARENAVECTOR<int> & spanLow, ARENA & arena)
+		: low(spanLow), order(spanLow.size(), 0, arena), position(spanLow.size(), 0, arena), maxHigh(arena)
+	{
+		while(leafNum < int(spanLow.size()))
+			leafNum *= 2;
+		maxHigh.assign(2 * leafNum, INT_MIN);
+		for(size_t id = 0; id < order.size(); id++)
+			order[id] = id;
+		sort(order.begin(), order.end(), [&](int a, int b) { return low[a] < low[b]; });
+		for(size_t leaf = 0; leaf < order.size(); leaf++)
+			position[order[leaf]] = leaf;
+		for(size_t leaf = 0; leaf < order.size(); leaf++)
+			low[leaf] = spanLow[order[leaf]];
+	}
+
+	void activate(int id, int high) { set(id, high); }
+	void deactivate(int id) { set(id, INT_MIN); }
+	// Active spans with low < queryHigh and high > queryLow
+	void query(int queryLow, int queryHigh, ARENAVECTOR<int> & found) const
+	{
+		found.clear();
+		const int limit = lower_bound(low.begin(), low.end(), queryHigh) - low.begin();
+		collect(1, 0, leafNum - 1, limit, queryLow, found);
+	}
+};
+
+// Part of a shape's inner span already faced by later shapes, as sorted disjoint spans
+struct COVERAGE
+{
+	ARENAVECTOR<array<int, 2>> span;
+	int covered = 0;
+
+	COVERAGE(ARENA & arena) : span(arena) {}
+
+	// Covers [low, high); returns the length newly covered and sets first to its lowest point
+	int cover(int low, int high, int & first)
+	{
+		auto begin = lower_bound(span.begin(), span.end(), low, [](const array<int, 2> & s, int value) { return s[1] < value; });
+		auto iter = begin;
+		int cursor = low, added = 0;
+		array<int, 2> merged {low, high};
+		first = -1;
+		for(; iter != span.end() && (*iter)[0] <= high; iter++)
+		{
+			if((*iter)[0] > cursor)
 			{
-				const GRIDTYPE nowType = gridInfo[coordinate[0]][coordinate[1]].type;
-				int width = layer.maxWidth / layer.gridSize(), width2 = layer.maxWidth / layer.gridSize(), height;
-				GRIDTYPE xType = nowType, xType2 = nowType;
-				bool same = false;
-				for(height = 0; height < layer.maxWidth / layer.gridSize() && coordinate[1] + height < gridInfo[0].size(); height++)
-				{
-					if(gridInfo[coordinate[0]][coordinate[1] + height].type != nowType)
-					{
-						if(nowType == GRIDTYPE::Critical)
-						{
-							if(gridInfo[coordinate[0]][coordinate[1] + height].type == GRIDTYPE::Empty)
-							{
-								height--;
-								if(same)
-								{
-									width = width2;
-									xType = xType2;
-								}
-							}
-							if(xType == GRIDTYPE::Empty)
-								width--;
-						}
-						break;
-					}
-					same = false;
-					for(int xMove = 1; xMove < width && coordinate[0] + xMove < gridInfo.size(); xMove++)
-					{
-						if(gridInfo[coordinate[0] + xMove][coordinate[1] + height].type != nowType)
-						{
-							if(height == 0)
-							{
-								width2 = xMove;
-								xType2 = gridInfo[coordinate[0] + xMove][coordinate[1] + height].type;
-							}
-							else
-							{
-								width2 = width;
-								xType2 = xType;
-							}
-							width = xMove;
-							xType = gridInfo[coordinate[0] + xMove][coordinate[1] + height].type;
-							same = true;
-						}
-					}
-				}
+				if(first < 0)
+					first = cursor;
+				added += (*iter)[0] - cursor;
+			}
+			cursor = max<int>(cursor, (*iter)[1]);
+			merged[0] = min<int>(merged[0], (*iter)[0]);
+			merged[1] = max<int>(merged[1], (*iter)[1]);
+		}
+		if(cursor < high)
+		{
+			if(first < 0)
+				first = cursor;
+			added += high - cursor;
+		}
+		begin = span.erase(begin, iter);
+		span.insert(begin, merged);
+		covered += added;
+		return added;
+	}
+};
 
-				DUMMY newDummy = {.inserted = (nowType == GRIDTYPE::Empty),
-								  .dummyID = int(dummyInfo.size()),
-								  .left = gridInfo[coordinate[0]][coordinate[1]].x,
-								  .bottom = gridInfo[coordinate[0]][coordinate[1]].y,
-								  .right = min<int>(gridInfo[coordinate[0]][coordinate[1]].x + width * layer.gridSize(), xMax),
-								  .top = min<int>(gridInfo[coordinate[0]][coordinate[1]].y + height * layer.gridSize(), yMax),
+// Fills the gaps between facing shapes of a region. Shapes are swept in (across, along)
+// order; each one keeps its inner span (one grid in from both ends) active until less
+// than three grids of it are left uncovered by the shapes found above it. A later shape
+// covers, within an active span, its own along extent widened by one grid, and when it
+// uncovers at least three grids at a distance of at least three grids, dummies are laid
+// from the first newly covered point. Dummies are emitted shape by shape in sweep order.
+// The working set lives in the region's scratch arena.
+template<DIRECTION D>
+void gapFill(const ARENAVECTOR<REGIONSHAPE> & shape, const LAYER & layer, vector<DUMMY> & filled, ARENA & scratch)
+{
+	const int grid = layer.gridSize();
+	ARENAVECTOR<int> spanLow (shape.size(), 0, scratch);
+	for(size_t id = 0; id < shape.size(); id++)
+		spanLow[id] = shape[id].alongLow + grid;
+	SPANINDEX active (spanLow, scratch);
+	ARENAVECTOR<COVERAGE> coverage (shape.size(), COVERAGE(scratch), scratch);
+	ARENAVECTOR<ARENAVECTOR<DUMMY>> shapeDummy (shape.size(), ARENAVECTOR<DUMMY>(scratch), scratch);
+	ARENAVECTOR<int> facing (scratch);
+
+	for(size_t id = 0; id < shape.size(); id++)
+	{
+		const REGIONSHAPE & upper = shape[id];
+		if(upper.merged)
+			continue;
+		active.query(upper.alongLow - grid, upper.alongHigh + grid, facing);
+		for(const auto & lowerID : facing)
+		{
+			const REGIONSHAPE & lower = shape[lowerID];
+			const int dist = upper.originalAcrossLow - lower.originalAcrossHigh;
+			if(dist < 0)
+				continue;
+			const int spanHigh = lower.alongHigh - grid;
+			int start, count = coverage[lowerID].cover(max<int>(upper.alongLow - grid, spanLow[lowerID]),
+													   min<int>(upper.alongHigh + grid, spanHigh), start);
+			if(spanHigh - spanLow[lowerID] - coverage[lowerID].covered < 3 * grid)
+				active.deactivate(lowerID);
+			if(dist < 3 * grid || count < 3 * grid)
+				continue;
+
+			const int acrossLow = lower.acrossHigh + grid, acrossHigh = upper.acrossLow - grid;
+			while(true)
+			{
+				int length = layer.maxWidth;
+				if(length > count)
+					length = count;
+				count -= (length + grid);
+
+				const bool horizontal = D == DIRECTION::Horizontal;
+				DUMMY newDummy = {.inserted = true,
+								  .dummyID = -1,
+								  .left = horizontal ? start : acrossLow,
+								  .bottom = horizontal ? acrossLow : start,
+								  .right = horizontal ? start + length : acrossHigh,
+								  .top = horizontal ? acrossHigh : start + length,
 								  .layerID = layer.layerID};
-				if(newDummy.right - newDummy.left < layer.minWidth || newDummy.top - newDummy.bottom < layer.minWidth)
-				{
-					findNext(coordinate[0] + 1, coordinate[1]);
-					findNext(coordinate[0], coordinate[1] + 1);
-					continue;
-				}
+				shapeDummy[lowerID].emplace_back(newDummy);
+				start += (length + grid);
 
-				dummyInfo.emplace_back(newDummy);
-				for(int y = max<int>(coordinate[1] - 1, 0); y <= coordinate[1] + height && y < gridInfo[0].size(); y++)
-				{
-					for(int x = coordinate[0]; x <= coordinate[0] + width && x < gridInfo.size(); x++)
-					{
-						GRID & nowGrid = gridInfo[x][y];
-						if(y >= coordinate[1] && y < coordinate[1] + height && x >= coordinate[0] && x < coordinate[0] + width)
-						{
-							if(nowGrid.type == GRIDTYPE::Empty)
-								nowGrid.type = GRIDTYPE::Dummy;
-							else if(nowGrid.type == GRIDTYPE::Critical)
-								nowGrid.type = GRIDTYPE::Reserved;
-							nowGrid.dummyID.emplace_back(newDummy.dummyID);
-						}
-						else
-							nowGrid.type = GRIDTYPE::Spacing;
-					}
+				if(count < grid)
+					break;
+			}
+		}
+		if(upper.alongHigh - upper.alongLow - 2 * grid >= 3 * grid)
+			active.activate(id, upper.alongHigh - grid);
+	}
 
-					for(int x = coordinate[0] + width + 1; (insertOrder.empty() && x < gridInfo.size()) || (!insertOrder.empty() && x < insertOrder.top()[0]); x++)
-					{
-						if(gridInfo[x][y].type == GRIDTYPE::Empty || gridInfo[x][y].type == GRIDTYPE::Critical)
-						{
-							insertOrder.push(array<int, 2> {x, y});
-							break;
-						}
-					}
-				}
+	for(const auto & dummies : shapeDummy)
+		filled.insert(filled.end(), dummies.begin(), dummies.end());
+}
+
+// Fills one region box from the conductors and the inserted dummies reaching into it.
+// Everything but the filled dummies is allocated from scratch, which the caller resets.
+template<DIRECTION D>
+void regionFill(const array<int, 4> & box, const GRIDMAP & gridInfo, const vector<DUMMY> & dummyInfo,
+				const vector<CONDUCTOR> & conductorInfo, const LAYER & layer, vector<DUMMY> & filled, ARENA & scratch)
+{
+	ARENAVECTOR<REGIONSHAPE> shape (scratch);
+	gridInfo.conductorIndex.query(box, [&](int id)
+	{
+		shape.emplace_back(regionShape<D>(conductorInfo[id], box, false, id));
+	});
+	gridInfo.dummyIndex.query(box, [&](int id)
+	{
+		if(dummyInfo[id].inserted)
+			shape.emplace_back(regionShape<D>(dummyInfo[id], box, true, id));
+	});
+	// Shapes sharing a lower-left corner are ordered conductors first, then by ID
+	sort(shape.begin(), shape.end(), [](const REGIONSHAPE & a, const REGIONSHAPE & b)
+	{
+		if(a.acrossLow != b.acrossLow)
+			return a.acrossLow < b.acrossLow;
+		else if(a.alongLow != b.alongLow)
+			return a.alongLow < b.alongLow;
+		else if(a.dummy != b.dummy)
+			return b.dummy;
+		else
+			return a.id < b.id;
+	});
+
+	// Shapes of the same kind on the same track closer than three grids act as one
+	for(size_t nowCombine = 0, nowCheck = 1; nowCheck < shape.size(); nowCheck++)
+	{
+		REGIONSHAPE & combine = shape[nowCombine];
+		REGIONSHAPE & check = shape[nowCheck];
+		if(combine.dummy == check.dummy &&
+		   combine.acrossLow == check.acrossLow &&
+		   combine.acrossHigh == check.acrossHigh &&
+		   check.alongLow - combine.alongHigh < 3 * layer.gridSize())
+		{
+			combine.alongHigh = check.alongHigh;
+			check.merged = true;
+		}
+		else
+			nowCombine = nowCheck;
+	}
+	gapFill<D>(shape, layer, filled, scratch);
+}
 
-				findNext(coordinate[0], coordinate[1] + height + 1);
+// Area of the union of rectangles {left, bottom, right, top}, split by x = xCut and y = yCut
+// into area[x >= xCut][y >= yCut]. The x coordinates are compressed into slabs and the
+// y intervals of the rectangles spanning each slab are merged, so the cost only depends
+// on the number of rectangles. Quadrants that receive no area are left untouched.
+void unionArea(const vector<array<int, 4>> & rect, const int & xCut, const int & yCut, long long area[2][2])
+{
+	vector<int> xs;
+	xs.reserve(2 * rect.size() + 1);
+	for(const auto & r : rect)
+	{
+		if(r[0] < r[2] && r[1] < r[3])
+		{
+			xs.emplace_back(r[0]);
+			xs.emplace_back(r[2]);
+		}
+	}
+	if(xs.empty())
+		return;
+	xs.emplace_back(xCut);
+	sort(xs.begin(), xs.end());
+	xs.erase(unique(xs.begin(), xs.end()), xs.end());
+
+	vector<array<int, 2>> interval;
+	for(size_t slab = 0; slab + 1 < xs.size(); slab++)
+	{
+		interval.clear();
+		for(const auto & r : rect)
+		{
+			if(r[0] <= xs[slab] && r[2] >= xs[slab + 1] && r[1] < r[3])
+				interval.emplace_back(array<int, 2> {r[1], r[3]});
+		}
+		if(interval.empty())
+			continue;
+		sort(interval.begin(), interval.end());
+		int below = 0, above = 0, low = interval.front()[0], high = interval.front()[1];
+		auto measure = [&]()
+		{
+			below += max<int>(min<int>(high, yCut) - low, 0);
+			above += max<int>(high - max<int>(low, yCut), 0);
+		};
+		for(const auto & span : interval)
+		{
+			if(span[0] > high)
+			{
+				measure();
+				low = span[0];
 			}
+			high = max<int>(high, span[1]);
 		}
+		measure();
+		const int xIdx = xs[slab] >= xCut ? 1 : 0;
+		area[xIdx][0] += (long long)(below) * (xs[slab + 1] - xs[slab]);
+		if(above > 0)
+			area[xIdx][1] += (long long)(above) * (xs[slab + 1] - xs[slab]);
 	}
 }
 
 void densityRefinement(const int & width, const int & height, const int & window, vector<DUMMY> & dummyInfo,
 					   const int & xMin, const int & xMax, const int & yMin, const int & yMax,
-					   vector<vector<GRID>> & gridInfo, LAYER & layer, const vector<CONDUCTOR> & conductorInfo)
+					   GRIDMAP & gridInfo, LAYER & layer, const vector<CONDUCTOR> & conductorInfo, LAYERSTAT & stat,
+					   vector<ARENA> & regionArena)
 {
-	vector<vector<DENSITYGRID>> density (width + WINDOW_MOVING_STEP - 1, vector<DENSITYGRID> (height + WINDOW_MOVING_STEP - 1));
+	STAGETIMER densityMapTimer (stat.densityMap.seconds);
+	stat.densityMap.cellsScanned = (long long)(gridInfo.size());
+	DENSITYMAP density (width, height, layer.minDensity, window);
+	const int latticeHeight = height + WINDOW_MOVING_STEP - 1;
+	const int latticeSize = (width + WINDOW_MOVING_STEP - 1) * latticeHeight;
+	auto LID = [&](int x, int y) { return x * latticeHeight + y; };
+	// {small window, Reserved dummy} pairs, turned into the candidate pool once the scan is done
+	vector<array<int, 2>> candidatePair;
+	CANDIDATEPOOL candidate;
 	int xDensity = 0, yDensity = 0;
-	for(auto & column : gridInfo)
+	vector<array<int, 4>> cellRect;
+	size_t conductorCursor = 0;
+	for(int gridX = 0; gridX < gridInfo.widthNum; gridX++)
 	{
 		bool xIncrease = false;
-		unsigned leftSmallWindowDensity = 0, rightSmallWindowDensity = 0;
-		for(auto & nowGrid : column)
+		long long leftSmallWindowDensity = 0, rightSmallWindowDensity = 0;
+		const int x = gridInfo.x(gridX);
+		const bool xDensitySeperate = gridInfo.xDensitySeperate[gridX];
+		const int xSeperate = gridInfo.xSeperate[gridX];
+		for(int gridY = 0; gridY < gridInfo.heightNum; gridY++)
 		{
-			if(nowGrid.type == GRIDTYPE::Conductor)
+			const size_t idx = gridInfo.id(gridX, gridY);
+			const int y = gridInfo.y(gridY);
+			const bool yDensitySeperate = gridInfo.yDensitySeperate[gridY];
+			const int ySeperate = gridInfo.ySeperate[gridY];
+			// Area of the cell falling into each of the (up to) four small windows it straddles
+			long long cellDensity[2][2] = {{0, -1}, {-1, -1}};
+			if(xDensitySeperate)
+				cellDensity[1][0] = 0;
+			if(yDensitySeperate)
+			{
+				cellDensity[0][1] = 0;
+				if(xDensitySeperate)
+					cellDensity[1][1] = 0;
+			}
+
+			if(gridInfo.cellType[idx] == GRIDTYPE::Conductor)
 			{
-				if(nowGrid.conductorID.size() == 1)
+				const IDRANGE cellConductor = gridInfo.conductorID(idx, conductorCursor);
+				if(cellConductor.size() <= 1)
 				{
-					const CONDUCTOR & nowConductor = conductorInfo[nowGrid.conductorID[0]];
-					if(nowGrid.xDensitySeperate && nowGrid.yDensitySeperate)
+					// A cell with no conductors listed is covered in full
+					const CONDUCTOR nowConductor = cellConductor.size() == 1 ? conductorInfo[cellConductor.front()]
+						: CONDUCTOR {0, x, y, x + layer.gridSize(), y + layer.gridSize(), 0, layer.layerID};
+					if(xDensitySeperate && yDensitySeperate)
 					{
-						nowGrid.density[0][0] = max<int>(min<int>(nowGrid.xSeperate, nowConductor.right) - max<int>(nowGrid.x, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.ySeperate, nowConductor.top) - max<int>(nowGrid.y, nowConductor.bottom), 0);
-						nowGrid.density[0][1] = max<int>(min<int>(nowGrid.xSeperate, nowConductor.right) - max<int>(nowGrid.x, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.y + layer.gridSize(), nowConductor.top) - max<int>(nowGrid.ySeperate, nowConductor.bottom), 0);
-						nowGrid.density[1][0] = max<int>(min<int>(nowGrid.x + layer.gridSize(), nowConductor.right) - max<int>(nowGrid.xSeperate, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.ySeperate, nowConductor.top) - max<int>(nowGrid.y, nowConductor.bottom), 0);
-						nowGrid.density[1][1] = max<int>(min<int>(nowGrid.x + layer.gridSize(), nowConductor.right) - max<int>(nowGrid.xSeperate, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.y + layer.gridSize(), nowConductor.top) - max<int>(nowGrid.ySeperate, nowConductor.bottom), 0);
+						cellDensity[0][0] = max<int>(min<int>(xSeperate, nowConductor.right) - max<int>(x, nowConductor.left), 0) *
+												max<int>(min<int>(ySeperate, nowConductor.top) - max<int>(y, nowConductor.bottom), 0);
+						cellDensity[0][1] = max<int>(min<int>(xSeperate, nowConductor.right) - max<int>(x, nowConductor.left), 0) *
+												max<int>(min<int>(y + layer.gridSize(), nowConductor.top) - max<int>(ySeperate, nowConductor.bottom), 0);
+						cellDensity[1][0] = max<int>(min<int>(x + layer.gridSize(), nowConductor.right) - max<int>(xSeperate, nowConductor.left), 0) *
+												max<int>(min<int>(ySeperate, nowConductor.top) - max<int>(y, nowConductor.bottom), 0);
+						cellDensity[1][1] = max<int>(min<int>(x + layer.gridSize(), nowConductor.right) - max<int>(xSeperate, nowConductor.left), 0) *
+												max<int>(min<int>(y + layer.gridSize(), nowConductor.top) - max<int>(ySeperate, nowConductor.bottom), 0);
 						
 					}
-					else if(nowGrid.xDensitySeperate)
+					else if(xDensitySeperate)
 					{
-						nowGrid.density[0][0] = max<int>(min<int>(nowGrid.xSeperate, nowConductor.right) - max<int>(nowGrid.x, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.y + layer.gridSize(), nowConductor.top) - max<int>(nowGrid.y, nowConductor.bottom), 0);
-						nowGrid.density[1][0] = max<int>(min<int>(nowGrid.x + layer.gridSize(), nowConductor.right) - max<int>(nowGrid.xSeperate, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.y + layer.gridSize(), nowConductor.top) - max<int>(nowGrid.y, nowConductor.bottom), 0);
+						cellDensity[0][0] = max<int>(min<int>(xSeperate, nowConductor.right) - max<int>(x, nowConductor.left), 0) *
+												max<int>(min<int>(y + layer.gridSize(), nowConductor.top) - max<int>(y, nowConductor.bottom), 0);
+						cellDensity[1][0] = max<int>(min<int>(x + layer.gridSize(), nowConductor.right) - max<int>(xSeperate, nowConductor.left), 0) *
+												max<int>(min<int>(y + layer.gridSize(), nowConductor.top) - max<int>(y, nowConductor.bottom), 0);
 					}
-					else if(nowGrid.yDensitySeperate)
+					else if(yDensitySeperate)
 					{
-						nowGrid.density[0][0] = max<int>(min<int>(nowGrid.x + layer.gridSize(), nowConductor.right) - max<int>(nowGrid.x, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.ySeperate, nowConductor.top) - max<int>(nowGrid.y, nowConductor.bottom), 0);
-						nowGrid.density[0][1] = max<int>(min<int>(nowGrid.x + layer.gridSize(), nowConductor.right) - max<int>(nowGrid.x, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.y + layer.gridSize(), nowConductor.top) - max<int>(nowGrid.ySeperate, nowConductor.bottom), 0);
+						cellDensity[0][0] = max<int>(min<int>(x + layer.gridSize(), nowConductor.right) - max<int>(x, nowConductor.left), 0) *
+												max<int>(min<int>(ySeperate, nowConductor.top) - max<int>(y, nowConductor.bottom), 0);
+						cellDensity[0][1] = max<int>(min<int>(x + layer.gridSize(), nowConductor.right) - max<int>(x, nowConductor.left), 0) *
+												max<int>(min<int>(y + layer.gridSize(), nowConductor.top) - max<int>(ySeperate, nowConductor.bottom), 0);
 					}
 					else
 					{
-						nowGrid.density[0][0] = max<int>(min<int>(nowGrid.x + layer.gridSize(), nowConductor.right) - max<int>(nowGrid.x, nowConductor.left), 0) *
-												max<int>(min<int>(nowGrid.y + layer.gridSize(), nowConductor.top) - max<int>(nowGrid.y, nowConductor.bottom), 0);
+						cellDensity[0][0] = max<int>(min<int>(x + layer.gridSize(), nowConductor.right) - max<int>(x, nowConductor.left), 0) *
+												max<int>(min<int>(y + layer.gridSize(), nowConductor.top) - max<int>(y, nowConductor.bottom), 0);
 					}
 				}
 				else
 				{
-					vector<vector<bool>> gridDensity (layer.gridSize(), vector<bool> (layer.gridSize(), false));
-					for(const auto & id : nowGrid.conductorID)
+					cellRect.clear();
+					for(const auto & id : cellConductor)
 					{
-
 						const CONDUCTOR & nowConductor = conductorInfo[id];
-						for(int x = max<int>(nowConductor.left - nowGrid.x, 0); x < min<int>(nowConductor.right - nowGrid.x, layer.gridSize()); x++)
-						{
-							for(int y = max<int>(nowConductor.bottom - nowGrid.y, 0); y < min<int>(nowConductor.top - nowGrid.y, layer.gridSize()); y++)
-							{
-								if(gridDensity[x][y] == false)
-								{
-									int xIdx = 0, yIdx = 0;
-									if(nowGrid.xDensitySeperate && x + nowGrid.x >= nowGrid.xSeperate)
-										xIdx = 1;
-									if(nowGrid.yDensitySeperate && y + nowGrid.y >= nowGrid.ySeperate)
-										yIdx = 1;
-									nowGrid.density[xIdx][yIdx]++;
-
-									gridDensity[x][y] = true;
-								}
-							}
-						}
+						cellRect.emplace_back(array<int, 4> {max<int>(nowConductor.left, x), max<int>(nowConductor.bottom, y),
+															 min<int>(nowConductor.right, x + layer.gridSize()),
+															 min<int>(nowConductor.top, y + layer.gridSize())});
 					}
+					unionArea(cellRect, xDensitySeperate ? xSeperate : x + layer.gridSize(),
+							  yDensitySeperate ? ySeperate : y + layer.gridSize(), cellDensity);
 				}
 			}
-			else if(nowGrid.type == GRIDTYPE::Dummy)
+			else if(gridInfo.cellType[idx] == GRIDTYPE::Dummy)
 			{
-				if(nowGrid.xDensitySeperate && nowGrid.yDensitySeperate)
+				if(xDensitySeperate && yDensitySeperate)
 				{
-					nowGrid.density[0][0] = (nowGrid.xSeperate - nowGrid.x) * (nowGrid.ySeperate - nowGrid.y);
-					nowGrid.density[0][1] = (nowGrid.xSeperate - nowGrid.x) * (min<int>(nowGrid.y + layer.gridSize(), yMax) - nowGrid.ySeperate);
-					nowGrid.density[1][0] = (min<int>(nowGrid.x + layer.gridSize(), xMax) - nowGrid.xSeperate) * (nowGrid.ySeperate - nowGrid.y);
-					nowGrid.density[1][1] = (min<int>(nowGrid.x + layer.gridSize(), xMax) - nowGrid.xSeperate) * (min<int>(nowGrid.y + layer.gridSize(), yMax) - nowGrid.ySeperate);
+					cellDensity[0][0] = (xSeperate - x) * (ySeperate - y);
+					cellDensity[0][1] = (xSeperate - x) * (min<int>(y + layer.gridSize(), yMax) - ySeperate);
+					cellDensity[1][0] = (min<int>(x + layer.gridSize(), xMax) - xSeperate) * (ySeperate - y);
+					cellDensity[1][1] = (min<int>(x + layer.gridSize(), xMax) - xSeperate) * (min<int>(y + layer.gridSize(), yMax) - ySeperate);
 				}
-				else if(nowGrid.xDensitySeperate)
+				else if(xDensitySeperate)
 				{
-					nowGrid.density[0][0] = (nowGrid.xSeperate - nowGrid.x) * (min<int>(nowGrid.y + layer.gridSize(), yMax) - nowGrid.y);
-					nowGrid.density[1][0] = (min<int>(nowGrid.x + layer.gridSize(), xMax) - nowGrid.xSeperate) * (min<int>(nowGrid.y + layer.gridSize(), yMax) - nowGrid.y);
+					cellDensity[0][0] = (xSeperate - x) * (min<int>(y + layer.gridSize(), yMax) - y);
+					cellDensity[1][0] = (min<int>(x + layer.gridSize(), xMax) - xSeperate) * (min<int>(y + layer.gridSize(), yMax) - y);
 				}
-				else if(nowGrid.yDensitySeperate)
+				else if(yDensitySeperate)
 				{
-					nowGrid.density[0][0] = (min<int>(nowGrid.x + layer.gridSize(), xMax) - nowGrid.x) * (nowGrid.ySeperate - nowGrid.y);
-					nowGrid.density[0][1] = (min<int>(nowGrid.x + layer.gridSize(), xMax) - nowGrid.x) * (min<int>(nowGrid.y + layer.gridSize(), yMax) - nowGrid.ySeperate);
+					cellDensity[0][0] = (min<int>(x + layer.gridSize(), xMax) - x) * (ySeperate - y);
+					cellDensity[0][1] = (min<int>(x + layer.gridSize(), xMax) - x) * (min<int>(y + layer.gridSize(), yMax) - ySeperate);
 				}
 				else
-					nowGrid.density[0][0] = (min<int>(nowGrid.x + layer.gridSize(), xMax) - nowGrid.x) * (min<int>(nowGrid.y + layer.gridSize(), yMax) - nowGrid.y);
+					cellDensity[0][0] = (min<int>(x + layer.gridSize(), xMax) - x) * (min<int>(y + layer.gridSize(), yMax) - y);
 			}
-			else if(nowGrid.type == GRIDTYPE::Reserved)
+			else if(gridInfo.cellType[idx] == GRIDTYPE::Reserved)
 			{
-				const int id = nowGrid.dummyID.front();
-				density[xDensity][yDensity].criticalDummyID.emplace(id);
-				if(nowGrid.xDensitySeperate && dummyInfo[id].right > nowGrid.xSeperate)
-					density[min<int>(xDensity + 1, width + WINDOW_MOVING_STEP - 2)][yDensity].criticalDummyID.emplace(id);
-				if(nowGrid.yDensitySeperate && dummyInfo[id].top > nowGrid.ySeperate)
-					density[xDensity][min<int>(yDensity + 1, height + WINDOW_MOVING_STEP - 2)].criticalDummyID.emplace(id);
-				if(nowGrid.xDensitySeperate && dummyInfo[id].right > nowGrid.xSeperate &&
-				   nowGrid.yDensitySeperate && dummyInfo[id].top > nowGrid.ySeperate)
-					density[min<int>(xDensity + 1, width + WINDOW_MOVING_STEP - 2)][min<int>(yDensity + 1, height + WINDOW_MOVING_STEP - 2)].criticalDummyID.emplace(id);
+				const int id = gridInfo.dummyID(idx).front();
+				candidatePair.emplace_back(array<int, 2> {LID(xDensity, yDensity), id});
+				if(xDensitySeperate && dummyInfo[id].right > xSeperate)
+					candidatePair.emplace_back(array<int, 2> {LID(min<int>(xDensity + 1, width + WINDOW_MOVING_STEP - 2), yDensity), id});
+				if(yDensitySeperate && dummyInfo[id].top > ySeperate)
+					candidatePair.emplace_back(array<int, 2> {LID(xDensity, min<int>(yDensity + 1, height + WINDOW_MOVING_STEP - 2)), id});
+				if(xDensitySeperate && dummyInfo[id].right > xSeperate &&
+				   yDensitySeperate && dummyInfo[id].top > ySeperate)
+					candidatePair.emplace_back(array<int, 2> {LID(min<int>(xDensity + 1, width + WINDOW_MOVING_STEP - 2), min<int>(yDensity + 1, height + WINDOW_MOVING_STEP - 2)), id});
 			}
 
-			leftSmallWindowDensity += nowGrid.density[0][0];
-			if(nowGrid.xDensitySeperate)
+			leftSmallWindowDensity += cellDensity[0][0];
+			if(xDensitySeperate)
 			{
 				xIncrease = true;
-				rightSmallWindowDensity += nowGrid.density[1][0];
+				rightSmallWindowDensity += cellDensity[1][0];
 			}
-			if(nowGrid.yDensitySeperate)
+			if(yDensitySeperate)
 			{
-				density[xDensity][yDensity].original += leftSmallWindowDensity;
-				if(nowGrid.xDensitySeperate && rightSmallWindowDensity > 0)
-					density[xDensity + 1][yDensity].original += rightSmallWindowDensity;
+				density.addOriginal(xDensity, yDensity, leftSmallWindowDensity);
+				if(xDensitySeperate && rightSmallWindowDensity > 0)
+					density.addOriginal(xDensity + 1, yDensity, rightSmallWindowDensity);
 
 				yDensity++;
-				leftSmallWindowDensity = nowGrid.density[0][1];
-				rightSmallWindowDensity = max<int>(nowGrid.density[1][1], 0);
+				leftSmallWindowDensity = cellDensity[0][1];
+				rightSmallWindowDensity = max<long long>(cellDensity[1][1], 0);
 			}
 		}
 		if(xIncrease)
@@ -673,121 +2186,68 @@ void densityRefinement(const int & width, const int & height, const int & window
 		yDensity = 0;
 	}
 
-	for(int x = width + WINDOW_MOVING_STEP - 2; x >= 0; x--)
-	{
-		const int right = (x + WINDOW_MOVING_STEP < width + WINDOW_MOVING_STEP - 1) ? x + WINDOW_MOVING_STEP : -1;
-		const bool nextR = (x + 1 < width + WINDOW_MOVING_STEP - 1);
-		for(int y = height + WINDOW_MOVING_STEP - 2; y >= 0; y--)
-		{
-			const int top = (y + WINDOW_MOVING_STEP < height + WINDOW_MOVING_STEP - 1) ? y + WINDOW_MOVING_STEP : -1;
-			const bool nextT = (y + 1 < height + WINDOW_MOVING_STEP - 1);
-
-			density[x][y].window = density[x][y].original;
-			if(nextR && nextT)
-				density[x][y].window += (density[x + 1][y].window + density[x][y + 1].window - density[x + 1][y + 1].window);
-			else if(nextR)
-				density[x][y].window += density[x + 1][y].window;
-			else if(nextT)
-				density[x][y].window += density[x][y + 1].window;
-
-			if(right != -1 && top != -1)
-				density[x][y].window -= (density[right][y].original + density[x][top].original - density[right][top].original);
-			else if(right != -1)
-				density[x][y].window -= density[right][y].original;
-			else if(top != -1)
-				density[x][y].window -= density[x][top].original;
-		}
-	}
-
-	unordered_map<int, int> criticalNeeded;
-	vector<array<int, 2>> sortedCriticalNeeded;
-
-	auto C2ID = [&](array<int, 2> xy)
-	{
-		if(layer.direction == DIRECTION::Horizontal)
-			return xy[0] + xy[1] * (width + WINDOW_MOVING_STEP - 1);
-		else if(layer.direction == DIRECTION::Vertical)
-			return xy[0] * (height + WINDOW_MOVING_STEP - 1) + xy[1];
-	};
-
-	auto ID2C = [&](int id)
-	{
-		if(layer.direction == DIRECTION::Horizontal)
-			return array<int, 2> {id % (width + WINDOW_MOVING_STEP - 1), id / (width + WINDOW_MOVING_STEP - 1)};
-		else if(layer.direction == DIRECTION::Vertical)
-			return array<int, 2> {id / (height + WINDOW_MOVING_STEP - 1), id % (height + WINDOW_MOVING_STEP - 1)};
-	};
+	density.build();
 
-	auto XY2ID = [&](int x, int y)
-	{
-		if(layer.direction == DIRECTION::Horizontal)
-			return x + y * (width + WINDOW_MOVING_STEP - 1);
-		else if(layer.direction == DIRECTION::Vertical)
-			return x * (height + WINDOW_MOVING_STEP - 1) + y;
-	};
+	densityMapTimer.stop();
+	STAGETIMER criticalTimer (stat.critical.seconds);
+	stat.critical.cellsScanned = (long long)(width) * height;
+	candidate.build(latticeSize, candidatePair, dummyInfo);
 
-	auto sortingCriticalNeeded = [&](array<int, 2> a, array<int, 2> b) { return criticalNeeded[C2ID(a)] < criticalNeeded[C2ID(b)]; };
+	// criticalNeeded counts the deficient windows each small window could still help.
+	// The window with the highest count is served first. Ties go to the larger stamp:
+	// stamps start in discovery order and are renewed whenever a count drops (windows
+	// dropping together keep their previous relative order), which is the order the
+	// repeatedly stable-sorted candidate list of the original loop produced.
+	vector<int> criticalNeeded (latticeSize, 0), criticalStamp (latticeSize, -1), droppedAt (latticeSize, -1);
+	vector<array<int, 3>> dropped;
+	INDEXEDHEAP criticalOrder (latticeSize, criticalNeeded, criticalStamp);
+	int nextStamp = 0, iteration = 0;
 
 	for(int x = 0; x < width; x++)
 	{
 		for(int y = 0; y < height; y++)
 		{
-			if(density[x][y].window < layer.minDensity * window * window)
+			if(density.deficient(x, y))
 			{
 				
 				for(int xMove = 0; xMove < WINDOW_MOVING_STEP; xMove++)
 				{
 					for(int yMove = 0; yMove < WINDOW_MOVING_STEP; yMove++)
 					{
-						const int id = XY2ID(x + xMove, y + yMove);
-						if(density[x + xMove][y + yMove].criticalDummyID.empty())
+						const int id = LID(x + xMove, y + yMove);
+						if(candidate.best(id, dummyInfo) < 0)
 							continue;
 						
-						if(criticalNeeded.find(id) == criticalNeeded.end())
-						{
-							criticalNeeded[id] = 1;
-							sortedCriticalNeeded.emplace_back(array<int, 2> {x + xMove, y + yMove});
-						}
-						else
-							criticalNeeded[id]++;
+						if(criticalStamp[id] < 0)
+							criticalStamp[id] = nextStamp++;
+						criticalNeeded[id]++;
 					}
 				}
 			}
 		}
 	}
-	if(criticalNeeded.empty())
+	if(nextStamp == 0)
 		goto nonCritical;
-	else
-		sort(sortedCriticalNeeded.begin(), sortedCriticalNeeded.end(), sortingCriticalNeeded);
+	for(int id = 0; id < latticeSize; id++)
+	{
+		if(criticalStamp[id] >= 0)
+			criticalOrder.push(id);
+	}
 
-	while(!sortedCriticalNeeded.empty())
+	while(!criticalOrder.empty())
 	{
-		array<int, 2> nowDensity = sortedCriticalNeeded.back();
-		if(criticalNeeded[C2ID(nowDensity)] == 0 || density[nowDensity[0]][nowDensity[1]].criticalDummyID.empty())
+		const int nowID = criticalOrder.top();
+		const int largestID = candidate.best(nowID, dummyInfo);
+		if(criticalNeeded[nowID] == 0 || largestID < 0)
 		{
-			sortedCriticalNeeded.pop_back();
+			criticalOrder.pop();
 			continue;
 		}
-		int largestID = -1, largestArea = -1;
-		for(const auto & id : density[nowDensity[0]][nowDensity[1]].criticalDummyID)
-		{
-			if(largestID == -1)
-			{
-				largestID = id;
-				largestArea = dummyInfo[id].area();
-			}
-			else
-			{
-				if(largestArea < dummyInfo[id].area())
-				{
-					largestID = id;
-					largestArea = dummyInfo[id].area();
-				}
-			}
-		}
+		iteration++;
 
 		DUMMY & nowDummy = dummyInfo[largestID];
 		nowDummy.inserted = true;
+		stat.dummiesPromoted++;
 		const int left = (nowDummy.left - xMin) / (window / WINDOW_MOVING_STEP);
 		const int right = (nowDummy.right - 1 - xMin) / (window / WINDOW_MOVING_STEP);
 		const int bottom = (nowDummy.bottom - yMin) / (window / WINDOW_MOVING_STEP);
@@ -798,615 +2258,1348 @@ void densityRefinement(const int & width, const int & height, const int & window
 			const int XMax = XMin + (window / WINDOW_MOVING_STEP);
 			for(int Y = bottom; Y <= top; Y++)
 			{
-				density[X][Y].criticalDummyID.erase(largestID);
 				const int YMin = Y * (window / WINDOW_MOVING_STEP) + yMin;
 				const int YMax = YMin + (window / WINDOW_MOVING_STEP);
 				const int area = (min<int>(nowDummy.right, XMax) - max<int>(nowDummy.left, XMin)) * (min<int>(nowDummy.top, YMax) - max<int>(nowDummy.bottom, YMin));
-				for(int x = max<int>(X - WINDOW_MOVING_STEP + 1, 0); x <= min<int>(X, width - 1); x++)
+				stat.critical.cellsScanned += density.add(X, Y, area, [&](int x, int y)
 				{
-					for(int y = max<int>(Y - WINDOW_MOVING_STEP + 1, 0); y <= min<int>(Y, height - 1); y++)
+					for(int xMove = 0; xMove < WINDOW_MOVING_STEP; xMove++)
 					{
-						density[x][y].window += area;
-						if(density[x][y].window >= layer.minDensity * window * window && (density[x][y].window - area) < layer.minDensity * window * window)
+						for(int yMove = 0; yMove < WINDOW_MOVING_STEP; yMove++)
 						{
-							for(int xMove = 0; xMove < WINDOW_MOVING_STEP; xMove++)
+							const int id = LID(x + xMove, y + yMove);
+							if(criticalStamp[id] < 0)
+								continue;
+							if(droppedAt[id] != iteration)
 							{
-								for(int yMove = 0; yMove < WINDOW_MOVING_STEP; yMove++)
-								{
-									if(criticalNeeded.find(XY2ID(x + xMove, y + yMove)) != criticalNeeded.end())
-									{
-										criticalNeeded[XY2ID(x + xMove, y + yMove)]--;
-									}
-								}
+								droppedAt[id] = iteration;
+								dropped.emplace_back(array<int, 3> {criticalNeeded[id], criticalStamp[id], id});
 							}
+							criticalNeeded[id]--;
+							if(criticalOrder.contains(id))
+								criticalOrder.update(id);
 						}
 					}
-				}
+				});
 			}
 		}
-		if(criticalNeeded[C2ID(nowDensity)] == 0)
-			sortedCriticalNeeded.pop_back();
-		sort(sortedCriticalNeeded.begin(), sortedCriticalNeeded.end(), sortingCriticalNeeded);
+
+		sort(dropped.begin(), dropped.end());
+		for(const auto & i : dropped)
+		{
+			criticalStamp[i[2]] = nextStamp++;
+			if(criticalOrder.contains(i[2]))
+				criticalOrder.update(i[2]);
+		}
+		dropped.clear();
+		if(criticalNeeded[nowID] == 0)
+			criticalOrder.remove(nowID);
 	}
 
 nonCritical:
 
-	set<int> dummyNeeded;
+	criticalTimer.stop();
+	STAGETIMER regionExtractionTimer (stat.regionExtraction.seconds);
+	stat.regionExtraction.cellsScanned = (long long)(width) * height;
+
+	DEFICITMAP dummyNeeded (width + WINDOW_MOVING_STEP - 1, latticeHeight);
 	for(int x = 0; x < width; x++)
 	{
 		for(int y = 0; y < height; y++)
 		{
-			if(density[x][y].window < layer.minDensity * window * window)
+			if(density.deficient(x, y))
 			{
 				
 				for(int xMove = 0; xMove < WINDOW_MOVING_STEP; xMove++)
 				{
 					for(int yMove = 0; yMove < WINDOW_MOVING_STEP; yMove++)
-						dummyNeeded.emplace(XY2ID(x + xMove, y + yMove));
+						dummyNeeded.set(x + xMove, y + yMove);
 				}
 			}
 		}
-	}
-	vector<array<int, 4>> regions;
-	while(!dummyNeeded.empty())
-	{
-		auto iter = dummyNeeded.begin();
-		array<int, 4> region { ID2C(*iter)[0], ID2C(*iter)[1], ID2C(*iter)[0], ID2C(*iter)[1] };
-		iter = dummyNeeded.erase(iter);
-		bool cont = false;
-		while(true && iter != dummyNeeded.end())
+	}
+	const vector<array<int, 4>> regions = regionExtraction(dummyNeeded, layer.direction, stat.regionExtraction.cellsScanned);
+
+	
+	regionExtractionTimer.stop();
+	STAGETIMER regionFillTimer (stat.regionFill.seconds);
+	stat.regions = regions.size();
+	const size_t dummyBeforeRegion = dummyInfo.size();
+
+	// Regions only read the conductors and the dummies placed by dummyInsertion, so they
+	// are filled concurrently into per-region buffers that are appended in region order.
+	// The threads left over by the layers in flight are shared among the regions; each
+	// thread works in its own arena of regionArena, reset before every region.
+	vector<vector<DUMMY>> regionDummy (regions.size());
+	long long regionCells = 0;
+	const int regionThreads = max<int>(omp_get_max_threads() / omp_get_num_threads(), 1);
+	if(int(regionArena.size()) < regionThreads)
+		regionArena.resize(regionThreads);
+	const auto fillRegion = (layer.direction == DIRECTION::Horizontal) ? &regionFill<DIRECTION::Horizontal> : &regionFill<DIRECTION::Vertical>;
+	#pragma omp parallel for schedule(dynamic, 1) num_threads(regionThreads) if(regions.size() > 1) reduction(+ : regionCells)
+	for(size_t regionID = 0; regionID < regions.size(); regionID++)
+	{
+		const array<int, 4> & region = regions[regionID];
+		vector<DUMMY> & filled = regionDummy[regionID];
+		const int eLeft = (max<int>(region[0] - 1, 0) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
+		const int eBottom = (max<int>(region[1] - 1, 0) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
+		const int eRight = (min<int>(region[2] + 2, width + WINDOW_MOVING_STEP - 1) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
+		const int eTop = (min<int>(region[3] + 2, height + WINDOW_MOVING_STEP - 1) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
+		const array<int, 4> box {eLeft * layer.gridSize() + xMin, eBottom * layer.gridSize() + yMin,
+								 eRight * layer.gridSize() + xMin, eTop * layer.gridSize() + yMin};
+		regionCells += (long long)(max<int>(eRight - eLeft, 0)) * max<int>(eTop - eBottom, 0);
+		ARENA & scratch = regionArena[omp_get_thread_num()];
+		scratch.reset();
+		fillRegion(box, gridInfo, dummyInfo, conductorInfo, layer, filled, scratch);
+	}
+
+	stat.regionFill.cellsScanned += regionCells;
+	for(auto & filled : regionDummy)
+	{
+		for(auto & newDummy : filled)
+		{
+			newDummy.dummyID = int(dummyInfo.size());
+			dummyInfo.emplace_back(newDummy);
+		}
+	}
+
+	stat.regionDummies = dummyInfo.size() - dummyBeforeRegion;
+	stat.dummiesCreated += stat.regionDummies;
+}
+
+// Binary fill format: a 16-byte header ("DFMB", version, layer count, reserved), then one
+// uint64 record count per layer, then the records layer by layer. Each record is five
+// int32 (left, bottom, right, top, layerID); every field is little-endian.
+#define BINARY_MAGIC "DFMB"
+#define BINARY_VERSION 1
+#define BINARY_RECORD_SIZE 20
+
+char * appendInt(char * p, int value)
+{
+	unsigned magnitude = value;
+	if(value < 0)
+	{
+		*p++ = '-';
+		magnitude = 0u - magnitude;
+	}
+	char digit[10];
+	int length = 0;
+	do
+	{
+		digit[length++] = char('0' + magnitude % 10);
+		magnitude /= 10;
+	} while(magnitude != 0);
+	while(length > 0)
+		*p++ = digit[--length];
+	return p;
+}
+
+char * appendLE(char * p, unsigned long long value, int bytes)
+{
+	for(int i = 0; i < bytes; i++)
+		*p++ = char((value >> (8 * i)) & 0xFF);
+	return p;
+}
+
+unsigned long long readLE(const char * p, int bytes)
+{
+	unsigned long long value = 0;
+	for(int i = 0; i < bytes; i++)
+		value |= (unsigned long long)(unsigned char)(p[i]) << (8 * i);
+	return value;
+}
+
+size_t insertedCount(const vector<DUMMY> & dummys)
+{
+	size_t count = 0;
+	for(const auto & i : dummys)
+		count += i.inserted;
+	return count;
+}
+
+string formatText(const vector<DUMMY> & dummys)
+{
+	// 5 fields of at most 11 characters, 4 separators and a newline
+	string buffer (insertedCount(dummys) * 60, '\0');
+	char * p = &buffer[0];
+	for(const auto & i : dummys)
+	{
+		if(!i.inserted)
+			continue;
+		p = appendInt(p, i.left);
+		*p++ = ' ';
+		p = appendInt(p, i.bottom);
+		*p++ = ' ';
+		p = appendInt(p, i.right);
+		*p++ = ' ';
+		p = appendInt(p, i.top);
+		*p++ = ' ';
+		p = appendInt(p, i.layerID);
+		*p++ = '\n';
+	}
+	buffer.resize(p - buffer.data());
+	return buffer;
+}
+
+string formatBinary(const vector<DUMMY> & dummys)
+{
+	string buffer (insertedCount(dummys) * BINARY_RECORD_SIZE, '\0');
+	char * p = &buffer[0];
+	for(const auto & i : dummys)
+	{
+		if(!i.inserted)
+			continue;
+		p = appendLE(p, unsigned(i.left), 4);
+		p = appendLE(p, unsigned(i.bottom), 4);
+		p = appendLE(p, unsigned(i.right), 4);
+		p = appendLE(p, unsigned(i.top), 4);
+		p = appendLE(p, unsigned(i.layerID), 4);
+	}
+	return buffer;
+}
+
+// Header of the binary fill format; count[i] is the record count of layer i (count[0] is unused)
+string binaryHeader(const vector<unsigned long long> & count)
+{
+	const int numLayer = int(count.size()) - 1;
+	string header (16 + 8 * numLayer, '\0');
+	char * p = &header[0];
+	p = copy(BINARY_MAGIC, BINARY_MAGIC + 4, p);
+	p = appendLE(p, BINARY_VERSION, 4);
+	p = appendLE(p, numLayer, 4);
+	p = appendLE(p, 0, 4);
+	for(int i = 1; i <= numLayer; i++)
+		p = appendLE(p, count[i], 8);
+	return header;
+}
+
+// dummyInfo[0] is unused, layers 1 .. size() - 1 are written in order. Every layer is
+// formatted into its own buffer in parallel, then the buffers go out with one fwrite each.
+bool writeFile(const char * file, const vector<vector<DUMMY>> & dummyInfo, bool binary = false)
+{
+	const int numLayer = int(dummyInfo.size()) - 1;
+	vector<string> buffer (dummyInfo.size());
+	#pragma omp parallel for schedule(dynamic, 1)
+	for(int i = 1; i <= numLayer; i++)
+		buffer[i] = binary ? formatBinary(dummyInfo[i]) : formatText(dummyInfo[i]);
+
+	if(binary)
+	{
+		vector<unsigned long long> count (dummyInfo.size(), 0);
+		for(int i = 1; i <= numLayer; i++)
+			count[i] = buffer[i].size() / BINARY_RECORD_SIZE;
+		buffer[0] = binaryHeader(count);
+	}
+
+	const bool standardOutput = (string(file) == "-");
+	FILE * output = standardOutput ? stdout : fopen(file, "wb");
+	if(output == nullptr)
+	{
+		cerr << "Cannot open output file " << file << endl;
+		return false;
+	}
+	bool success = true;
+	for(const auto & i : buffer)
+		success &= (fwrite(i.data(), 1, i.size(), output) == i.size());
+	success &= (standardOutput ? fflush(output) : fclose(output)) == 0;
+	if(!success)
+		cerr << "Failed writing output file " << file << endl;
+	return success;
+}
+
+// Writes fills while they are produced, layer by layer in order, in the same formats as
+// writeFile. The binary header is written with zero counts and patched by close(), so
+// binary streaming needs a seekable output file.
+struct FILLSTREAM
+{
+	FILE * output = nullptr;
+	bool binary = false, standardOutput = false, success = true;
+	vector<unsigned long long> count;
+
+	bool open(const char * file, int numLayer, bool binaryOutput)
+	{
+		binary = binaryOutput;
+		standardOutput = (string(file) == "-");
+		count.assign(numLayer + 1, 0);
+		output = standardOutput ? stdout : fopen(file, "wb");
+		if(output == nullptr)
+		{
+			cerr << "Cannot open output file " << file << endl;
+			return false;
+		}
+		if(binary)
+		{
+			const string header = binaryHeader(count);
+			success &= (fwrite(header.data(), 1, header.size(), output) == header.size());
+		}
+		return true;
+	}
+
+	void write(int layerID, const vector<DUMMY> & dummys)
+	{
+		const string buffer = binary ? formatBinary(dummys) : formatText(dummys);
+		count[layerID] += insertedCount(dummys);
+		success &= (fwrite(buffer.data(), 1, buffer.size(), output) == buffer.size());
+	}
+
+	bool close()
+	{
+		if(binary)
+		{
+			const string header = binaryHeader(count);
+			success &= (fseek(output, 0, SEEK_SET) == 0);
+			success &= (fwrite(header.data(), 1, header.size(), output) == header.size());
+		}
+		success &= (standardOutput ? fflush(output) : fclose(output)) == 0;
+		output = nullptr;
+		return success;
+	}
+};
+
+// Parses a binary fill file held in input into dummyInfo, one entry per layer of the file
+bool readBinaryFill(const INPUTBUFFER & input, const char * file, vector<vector<DUMMY>> & dummyInfo)
+{
+	const size_t size = input.end - input.now;
+	const char * p = input.now;
+	if(size < 16 || !equal(p, p + 4, BINARY_MAGIC) || readLE(p + 4, 4) != BINARY_VERSION)
+	{
+		cerr << file << " is not a version " << BINARY_VERSION << " binary fill file" << endl;
+		return false;
+	}
+	const unsigned long long layerCount = readLE(p + 8, 4);
+	bool valid = (layerCount <= (size - 16) / 8);
+	const int numLayer = valid ? int(layerCount) : 0;
+	size_t offset = 16 + 8 * size_t(numLayer), total = 0;
+	for(int i = 0; i < numLayer; i++)
+		total += readLE(p + 16 + 8 * i, 8);
+	if(!valid || total > (size - offset) / BINARY_RECORD_SIZE || size - offset != total * BINARY_RECORD_SIZE)
+	{
+		cerr << file << " is truncated" << endl;
+		return false;
+	}
+
+	dummyInfo.assign(numLayer + 1, vector<DUMMY> ());
+	for(int i = 1; i <= numLayer; i++)
+	{
+		dummyInfo[i].resize(readLE(p + 16 + 8 * (i - 1), 8));
+		for(auto & dummy : dummyInfo[i])
+		{
+			const char * record = p + offset;
+			dummy.inserted = true;
+			dummy.dummyID = int(&dummy - dummyInfo[i].data());
+			dummy.left = int(readLE(record, 4));
+			dummy.bottom = int(readLE(record + 4, 4));
+			dummy.right = int(readLE(record + 8, 4));
+			dummy.top = int(readLE(record + 12, 4));
+			dummy.layerID = int(readLE(record + 16, 4));
+			offset += BINARY_RECORD_SIZE;
+		}
+	}
+	return true;
+}
+
+// Turns a binary fill file back into the text format written by writeFile.
+bool convertFile(const char * binaryFile, const char * textFile)
+{
+	INPUTBUFFER input;
+	if(!input.open(binaryFile))
+	{
+		cerr << "Cannot open binary file " << binaryFile << endl;
+		return false;
+	}
+	vector<vector<DUMMY>> dummyInfo;
+	const bool valid = readBinaryFill(input, binaryFile, dummyInfo);
+	input.close();
+
+	return valid && writeFile(textFile, dummyInfo);
+}
+
+// Reads a fill file in either format written by writeFile (binary files are told apart
+// by their magic) into dummyInfo[1 .. numLayer]. Fills keep the order of the file.
+bool readFill(const char * file, int numLayer, vector<vector<DUMMY>> & dummyInfo)
+{
+	INPUTBUFFER input;
+	if(!input.open(file))
+	{
+		cerr << "Cannot open fill file " << file << endl;
+		return false;
+	}
+
+	bool valid = true;
+	if(input.end - input.now >= 4 && equal(input.now, input.now + 4, BINARY_MAGIC))
+	{
+		if(!readBinaryFill(input, file, dummyInfo))
+		{
+			input.close();
+			return false;
+		}
+		for(size_t i = numLayer + 1; i < dummyInfo.size(); i++)
+			valid &= dummyInfo[i].empty();
+		dummyInfo.resize(numLayer + 1);
+	}
+	else
+	{
+		dummyInfo.assign(numLayer + 1, vector<DUMMY> ());
+		input.skipSpace();
+		while(valid && input.now < input.end)
+		{
+			DUMMY dummy;
+			dummy.inserted = true;
+			dummy.left = input.readInt();
+			dummy.bottom = input.readInt();
+			dummy.right = input.readInt();
+			dummy.top = input.readInt();
+			dummy.layerID = input.readInt();
+			valid = (dummy.layerID >= 1 && dummy.layerID <= numLayer);
+			if(valid)
+			{
+				dummy.dummyID = int(dummyInfo[dummy.layerID].size());
+				dummyInfo[dummy.layerID].emplace_back(dummy);
+			}
+			input.skipSpace();
+		}
+	}
+	input.close();
+	if(!valid)
+		cerr << file << " holds fills outside layers 1 .. " << numLayer << endl;
+	return valid;
+}
+
+// Per-layer result cache: a directory of single-layer binary fill files, each named
+// after a hash of everything the fill of its layer depends on. Entries are written to a
+// private temporary file and renamed into place, so concurrent runs only ever see
+// complete entries, and a hit renews the entry's time for the least recently used
+// eviction of trimCache. Bump CACHE_VERSION whenever the fills a layer gets change.
+#define CACHE_VERSION 1
+#define CACHE_SUFFIX ".fill"
+
+// 128-bit hash of a stream of integers, as two independently seeded lanes
+struct CONTENTHASH
+{
+	unsigned long long lane[2] = {0x9E3779B97F4A7C15ull, 0xD6E8FEB86659FD93ull};
+
+	void add(long long value)
+	{
+		const unsigned long long word = (unsigned long long)(value);
+		lane[0] = (((lane[0] << 31) | (lane[0] >> 33)) ^ word) * 0xBF58476D1CE4E5B9ull;
+		lane[1] = (((lane[1] << 23) | (lane[1] >> 41)) ^ word) * 0x94D049BB133111EBull;
+	}
+	void add(float value)
+	{
+		unsigned bits;
+		memcpy(&bits, &value, sizeof(bits));
+		add((long long)(bits));
+	}
+	string hex() const
+	{
+		string text;
+		for(unsigned long long h : lane)
+		{
+			h ^= h >> 30;
+			h *= 0xBF58476D1CE4E5B9ull;
+			h ^= h >> 27;
+			h *= 0x94D049BB133111EBull;
+			h ^= h >> 31;
+			for(int shift = 60; shift >= 0; shift -= 4)
+				text += "0123456789abcdef"[(h >> shift) & 0xF];
+		}
+		return text;
+	}
+};
+
+// Path of the cache entry of a layer in directory: the die, the window, the layer rules,
+// its conductors in layer order with their critical membership, the build constants and
+// the options that change the fill
+string cacheEntry(const string & directory, const int & xMin, const int & xMax, const int & yMin, const int & yMax,
+				  const int & window, const CRITICALNET & criticalNet, const LAYER & layer,
+				  const vector<CONDUCTOR> & conductorInfo, const int & strips)
+{
+	CONTENTHASH hash;
+	for(const long long value : {(long long)(CACHE_VERSION), (long long)(WINDOW_MOVING_STEP), (long long)(SAFE_SPACING),
+								 (long long)(xMin), (long long)(xMax), (long long)(yMin), (long long)(yMax), (long long)(window),
+								 (long long)(strips), (long long)(layer.layerID), (long long)(layer.minWidth),
+								 (long long)(layer.minSpacing), (long long)(layer.maxWidth)})
+		hash.add(value);
+	hash.add(layer.minDensity);
+	hash.add(layer.maxDensity);
+	hash.add(layer.weight);
+	hash.add((long long)(layer.conductorID.size()));
+	for(const int & id : layer.conductorID)
+	{
+		const CONDUCTOR & conductor = conductorInfo[id];
+		for(const long long value : {(long long)(id), (long long)(conductor.left), (long long)(conductor.bottom),
+									 (long long)(conductor.right), (long long)(conductor.top),
+									 (long long)(criticalNet.netID.count(conductor.netID))})
+			hash.add(value);
+	}
+	return directory + "/" + hash.hex() + CACHE_SUFFIX;
+}
+
+// Loads the fills of layer from its cache entry; false if there is no usable entry
+bool loadCache(const string & entry, const LAYER & layer, vector<DUMMY> & dummyInfo)
+{
+	INPUTBUFFER input;
+	if(!input.open(entry.c_str()))
+		return false;
+	vector<vector<DUMMY>> cached;
+	bool valid = readBinaryFill(input, entry.c_str(), cached) && cached.size() == 2;
+	input.close();
+	for(size_t i = 0; valid && i < cached[1].size(); i++)
+		valid = (cached[1][i].layerID == layer.layerID);
+	if(!valid)
+		return false;
+	dummyInfo = move(cached[1]);
+	utimensat(AT_FDCWD, entry.c_str(), nullptr, 0);
+	return true;
+}
+
+// Stores the fills of a layer under entry. The cache is best effort: failures only cost
+// the entry.
+void storeCache(const string & entry, const LAYER & layer, const vector<DUMMY> & dummyInfo)
+{
+	const string temporary = entry + ".tmp" + to_string(getpid()) + "." + to_string(layer.layerID);
+	const string record = formatBinary(dummyInfo);
+	const string header = binaryHeader(vector<unsigned long long> {0, record.size() / BINARY_RECORD_SIZE});
+	FILE * output = fopen(temporary.c_str(), "wb");
+	if(output == nullptr)
+		return;
+	bool success = fwrite(header.data(), 1, header.size(), output) == header.size() &&
+				   fwrite(record.data(), 1, record.size(), output) == record.size();
+	success &= (fclose(output) == 0);
+	if(!success || rename(temporary.c_str(), entry.c_str()) != 0)
+		unlink(temporary.c_str());
+}
+
+// Evicts the least recently used entries of directory until they fit in limit bytes,
+// along with temporary files left behind for over an hour by runs that died. Entries
+// another run removes first are skipped.
+void trimCache(const string & directory, const long long & limit)
+{
+	DIR * folder = opendir(directory.c_str());
+	if(folder == nullptr)
+		return;
+	const time_t now = time(nullptr);
+	vector<pair<time_t, string>> entry;
+	unordered_map<string, long long> entrySize;
+	long long total = 0;
+	const string suffix = CACHE_SUFFIX;
+	while(const dirent * item = readdir(folder))
+	{
+		const string name = item->d_name, path = directory + "/" + name;
+		struct stat status;
+		if(name[0] == '.' || stat(path.c_str(), &status) != 0 || !S_ISREG(status.st_mode))
+			continue;
+		if(name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+		{
+			entry.emplace_back(status.st_mtime, path);
+			entrySize[path] = status.st_size;
+			total += status.st_size;
+		}
+		else if(name.find(suffix + ".tmp") != string::npos && now - status.st_mtime > 3600)
+			unlink(path.c_str());
+	}
+	closedir(folder);
+
+	sort(entry.begin(), entry.end());
+	for(size_t i = 0; i < entry.size() && total > limit; i++)
+	{
+		unlink(entry[i].second.c_str());
+		total -= entrySize[entry[i].second];
+	}
+}
+
+void layerProcessing(const int & xMin, const int & xMax, const int & yMin, const int & yMax, const int & window,
+					 const CRITICALNET & criticalNet, LAYER & layer, const vector<CONDUCTOR> & conductorInfo,
+					 vector<DUMMY> & dummyInfo, LAYERSTAT & stat, const int & strips)
+{
+	STAGETIMER timer (stat.seconds);
+	auto progress = [&](const char * stage)
+	{
+		#pragma omp critical(progress)
+		{
+			cout << "[ Layer " << layer.layerID << " ] " << stage << endl; cout.flush();
+		}
+	};
+
+	progress("Grid Creation ...");
+	GRIDMAP gridInfo = gridCreation(xMin, xMax, yMin, yMax, window,
+												 criticalNet, layer, conductorInfo, stat);
+	progress("Dummy Fill Insertion ...");
+	dummyInsertion(dummyInfo, xMax, yMax, gridInfo, layer, conductorInfo, stat, strips);
+	progress("Density Refinement ...");
+	vector<ARENA> regionArena;
+	densityRefinement((xMax - xMin) / (window / WINDOW_MOVING_STEP) - WINDOW_MOVING_STEP + 1,
+					  (yMax - yMin) / (window / WINDOW_MOVING_STEP) - WINDOW_MOVING_STEP + 1,
+					  window, dummyInfo, xMin, xMax, yMin, yMax, gridInfo, layer, conductorInfo, stat, regionArena);
+	progress("Done");
+}
+
+// Routing direction of a whole layer, decided the way gridCreation does it
+DIRECTION layerDirection(const LAYER & layer, const vector<CONDUCTOR> & conductorInfo)
+{
+	int horizontal = 0, vertical = 0;
+	for(const int & id : layer.conductorID)
+	{
+		const int width = conductorInfo[id].right - conductorInfo[id].left;
+		const int height = conductorInfo[id].top - conductorInfo[id].bottom;
+		if(width > height)
+			horizontal++;
+		else if(width < height)
+			vertical++;
+	}
+	return (horizontal >= vertical) ? DIRECTION::Horizontal : DIRECTION::Vertical;
+}
+
+// Step that keeps both the grid of a layer and the small-window lattice in place when a
+// sub-die is cut out of the die at a multiple of it: lcm(gridSize, smallWindow)
+long long tileAlign(const LAYER & layer, const int & smallWindow)
+{
+	int divisor = layer.gridSize(), rest = smallWindow;
+	while(rest != 0)
+	{
+		const int next = divisor % rest;
+		divisor = rest;
+		rest = next;
+	}
+	return (long long)(layer.gridSize()) / divisor * smallWindow;
+}
+
+// Solves the part box of a layer as a small die and returns the fills whose lower-left
+// corner lies in coreBox. conductorID lists the layer conductors reaching box; fixed
+// holds fills placed earlier, which take part as non-critical shapes. box must be
+// aligned with tileAlign and keep the layer direction given in layer. regionArena is
+// the region scratch of the layer, kept from one tile to the next.
+vector<DUMMY> tileFill(const array<int, 4> & box, const array<int, 4> & coreBox, const int & window,
+					   const CRITICALNET & criticalNet, const LAYER & layer, const vector<CONDUCTOR> & conductorInfo,
+					   const IDRANGE & conductorID, const vector<DUMMY> & fixed, LAYERSTAT & stat, vector<ARENA> & regionArena)
+{
+	const int smallWindow = window / WINDOW_MOVING_STEP;
+	LAYER tileLayer = layer;
+	tileLayer.conductorID.clear();
+	vector<CONDUCTOR> tileConductor;
+	auto addShape = [&](CONDUCTOR shape)
+	{
+		shape.left = max<int>(shape.left, box[0]);
+		shape.bottom = max<int>(shape.bottom, box[1]);
+		shape.right = min<int>(shape.right, box[2]);
+		shape.top = min<int>(shape.top, box[3]);
+		if(shape.left >= shape.right || shape.bottom >= shape.top)
+			return;
+		shape.conductorID = int(tileConductor.size());
+		tileLayer.conductorID.emplace_back(shape.conductorID);
+		tileConductor.emplace_back(shape);
+	};
+	for(const int & id : conductorID)
+		addShape(conductorInfo[id]);
+	for(const auto & dummy : fixed)
+	{
+		CONDUCTOR shape = {.conductorID = -1, .left = dummy.left, .bottom = dummy.bottom, .right = dummy.right, .top = dummy.top,
+						   .netID = -1, .layerID = layer.layerID};
+		addShape(shape);
+	}
+
+	vector<DUMMY> tileDummy;
+	LAYERSTAT tileStat;
+	{
+		GRIDMAP gridInfo = gridCreation(box[0], box[2], box[1], box[3], window,
+										criticalNet, tileLayer, tileConductor, tileStat);
+		tileLayer.direction = layer.direction;
+		dummyInsertion(tileDummy, box[2], box[3], gridInfo, tileLayer, tileConductor, tileStat, 1);
+		densityRefinement((box[2] - box[0]) / smallWindow - WINDOW_MOVING_STEP + 1,
+						  (box[3] - box[1]) / smallWindow - WINDOW_MOVING_STEP + 1,
+						  window, tileDummy, box[0], box[2], box[1], box[3], gridInfo, tileLayer, tileConductor, tileStat,
+						  regionArena);
+	}
+
+	vector<DUMMY> kept;
+	for(const auto & dummy : tileDummy)
+	{
+		if(!dummy.inserted)
+			continue;
+		if(dummy.left >= coreBox[0] && dummy.left < coreBox[2] && dummy.bottom >= coreBox[1] && dummy.bottom < coreBox[3])
+			kept.emplace_back(dummy);
+		else
+			tileStat.tileDummiesDropped++;
+	}
+	addStat(stat, tileStat);
+	return kept;
+}
+
+// Tiled mode for dies whose grid does not fit in memory. Every layer is cut into tiles
+// of tileWindow windows, aligned to both its grid and the small-window lattice so that
+// cells and small windows coincide with those of an untiled run. A tile is solved as a
+// small die made of its core plus a halo. Fills already written by earlier tiles that
+// reach into the halo take part as fixed non-critical shapes. A tile keeps and streams
+// the fills whose lower-left corner lies in its core or in a band of one window and one
+// fill extent left of and below it, where the tiles written before it lie. Every window
+// then lies in the kept area of the last tile it touches, which solves it with all the
+// fills of the earlier tiles in place and can add to both sides of the seams it crosses;
+// later tiles only add fills. The halo covers the band plus a fill extent, SAFE_SPACING
+// and one more window. Layers go one after another and each tile uses all threads, so
+// peak memory follows the tile size rather than the die area. With keepFills the fills
+// streamed out are also collected in dummyInfo, for the verifier.
+bool tiledProcessing(const int & xMin, const int & xMax, const int & yMin, const int & yMax, const int & window,
+					 const int & tileWindow, const CRITICALNET & criticalNet, vector<LAYER> & layerInfo,
+					 const vector<CONDUCTOR> & conductorInfo, FILLSTREAM & output, vector<LAYERSTAT> & stat,
+					 vector<vector<DUMMY>> & dummyInfo, const bool & keepFills)
+{
+	const int smallWindow = window / WINDOW_MOVING_STEP;
+	for(size_t i = 1; i < layerInfo.size(); i++)
+	{
+		LAYER & layer = layerInfo[i];
+		STAGETIMER timer (stat[i].seconds);
+
+		// The routing direction is decided on the whole layer, as gridCreation does
+		layer.direction = layerDirection(layer, conductorInfo);
+
+		const long long align = tileAlign(layer, smallWindow);
+		auto alignUp = [&](long long length) { return max<long long>((length + align - 1) / align, 1) * align; };
+		const long long core = alignUp((long long)(tileWindow) * window), band = window + layer.maxWidth;
+		const long long halo = alignUp(SAFE_SPACING + window + band);
+		const int tileXNum = int((xMax - xMin + core - 1) / core), tileYNum = int((yMax - yMin + core - 1) / core);
+		auto tileBox = [&](int tx, int ty, long long margin)
+		{
+			return array<int, 4> {int(max<long long>(xMin + tx * core - margin, xMin)), int(max<long long>(yMin + ty * core - margin, yMin)),
+								  int(min<long long>(xMin + (tx + 1) * core + margin, xMax)), int(min<long long>(yMin + (ty + 1) * core + margin, yMax))};
+		};
+		auto tileRange = [&](int low, int high, int origin, int tileNum)
+		{
+			return array<int, 2> {int(max<long long>((low - origin - halo) / core, 0)),
+								  int(min<long long>((high - origin + halo + core - 1) / core - 1, tileNum - 1))};
+		};
+
+		// Conductors are bucketed per tile (halo included) in layer order
+		vector<int> tileStart (size_t(tileXNum) * tileYNum + 1, 0), tileList;
+		auto forTiles = [&](const CONDUCTOR & conductor, const function<void (size_t)> & visit)
+		{
+			const array<int, 2> xRange = tileRange(conductor.left, conductor.right, xMin, tileXNum);
+			const array<int, 2> yRange = tileRange(conductor.bottom, conductor.top, yMin, tileYNum);
+			for(int tx = xRange[0]; tx <= xRange[1]; tx++)
+				for(int ty = yRange[0]; ty <= yRange[1]; ty++)
+					visit(size_t(ty) * tileXNum + tx);
+		};
+		for(const int & id : layer.conductorID)
+			forTiles(conductorInfo[id], [&](size_t tile) { tileStart[tile]++; });
+		csrPrefix(tileStart, tileList);
+		for(auto iter = layer.conductorID.rbegin(); iter != layer.conductorID.rend(); iter++)
+			forTiles(conductorInfo[*iter], [&](size_t tile) { tileList[--tileStart[tile]] = *iter; });
+
+		#pragma omp critical(progress)
+		{
+			cout << "[ Layer " << layer.layerID << " ] " << tileXNum * tileYNum << " tiles ..." << endl; cout.flush();
+		}
+
+		vector<DUMMY> frontier;
+		vector<ARENA> regionArena;
+		for(int ty = 0; ty < tileYNum; ty++)
 		{
-			const array<int, 2> xy = ID2C(*iter);
-			if(xy[1] >= region[1] && xy[1] <= region[3] && xy[0] >= region[0] && xy[0] <= region[2])
-			{
-				iter = dummyNeeded.erase(iter);
-			}
-			else if(xy[1] >= region[1] && xy[1] <= region[3])
-			{
-				if(xy[0] == region[0] - 1)
-				{
-					cont = true;
-					iter = dummyNeeded.erase(iter);
-					region[0] = xy[0];
-				}
-				else if(xy[0] == region[2] + 1)
-				{
-					cont = true;
-					iter = dummyNeeded.erase(iter);
-					region[2] = xy[0];
-				}
-				else
-					iter++;
-			}
-			else if(xy[0] >= region[0] && xy[0] <= region[2])
+			for(int tx = 0; tx < tileXNum; tx++)
 			{
-				if(xy[1] == region[1] - 1)
+				const array<int, 4> box = tileBox(tx, ty, halo), coreBox = tileBox(tx, ty, 0);
+				const array<int, 4> keep {int(max<long long>(coreBox[0] - band, xMin)), int(max<long long>(coreBox[1] - band, yMin)),
+										  coreBox[2], coreBox[3]};
+				const size_t tile = size_t(ty) * tileXNum + tx;
+				const IDRANGE tileConductor {tileList.data() + tileStart[tile], tileList.data() + tileStart[tile + 1]};
+				const vector<DUMMY> kept = tileFill(box, keep, window, criticalNet, layer, conductorInfo,
+													tileConductor, frontier, stat[i], regionArena);
+				stat[i].tiles++;
+				output.write(layer.layerID, kept);
+				if(keepFills)
 				{
-					cont = true;
-					iter = dummyNeeded.erase(iter);
-					region[1] = xy[1];
-				}
-				else if(xy[1] == region[3] + 1)
-				{
-					cont = true;
-					iter = dummyNeeded.erase(iter);
-					region[3] = xy[1];
-				}
-				else
-					iter++;
-			}
-			else
-				iter++;
-			if(iter == dummyNeeded.end())
-			{
-				if(cont)
-				{
-					iter = dummyNeeded.begin();
-					cont = false;
+					for(DUMMY dummy : kept)
+					{
+						dummy.dummyID = int(dummyInfo[i].size());
+						dummyInfo[i].emplace_back(dummy);
+					}
 				}
-				else
+
+				// Keep the fills that can still reach the halo of a later tile
+				const long long nextLeft = xMin + (tx + 1) * core - halo, nextBottom = yMin + (ty + 1) * core - halo;
+				frontier.insert(frontier.end(), kept.begin(), kept.end());
+				frontier.erase(remove_if(frontier.begin(), frontier.end(), [&](const DUMMY & dummy)
 				{
-					break;
-				}
+					return dummy.right <= nextLeft && dummy.top <= nextBottom;
+				}), frontier.end());
 			}
 		}
-		regions.emplace_back(region);
+
+		#pragma omp critical(progress)
+		{
+			cout << "[ Layer " << layer.layerID << " ] Done" << endl; cout.flush();
+		}
 	}
+	return output.success;
+}
 
-	
-	auto distance = [&](array<int, 2> a, array<int, 2> b)
-	{
-		if(layer.direction == DIRECTION::Horizontal)
-		{
-			if(a[1] == 0 && b[1] == 0)
-				return conductorInfo[b[0]].bottom - conductorInfo[a[0]].top;
-			else if(a[1] == 0 && b[1] == 1)
-				return dummyInfo[b[0]].bottom - conductorInfo[a[0]].top;
-			else if(a[1] == 1 && b[1] == 0)
-				return conductorInfo[b[0]].bottom - dummyInfo[a[0]].top;
-			else if(a[1] == 1 && b[1] == 1)
-				return dummyInfo[b[0]].bottom - dummyInfo[a[0]].top;
-		}
-		else if(layer.direction == DIRECTION::Vertical)
-		{
-			if(a[1] == 0 && b[1] == 0)
-				return conductorInfo[b[0]].left - conductorInfo[a[0]].right;
-			else if(a[1] == 0 && b[1] == 1)
-				return dummyInfo[b[0]].left - conductorInfo[a[0]].right;
-			else if(a[1] == 1 && b[1] == 0)
-				return conductorInfo[b[0]].left - dummyInfo[a[0]].right;
-			else if(a[1] == 1 && b[1] == 1)
-				return dummyInfo[b[0]].left - dummyInfo[a[0]].right;
+// ECO re-fill of one layer: dummyInfo holds the previous fills of the layer and changed
+// the old and the new shape of every conductor the delta touched. A change claims the
+// area its windows, its critical SAFE_SPACING halo and the fills it may now collide with
+// can reach, aligned like a tile; overlapping claims are merged into zones. Each zone
+// drops the previous fills lying inside it and is solved as a tile against the updated
+// conductors and the fills around it, so the work follows the size of the change and
+// every fill outside the zones is kept verbatim. New fills are appended to dummyInfo.
+void ecoProcessing(const int & xMin, const int & xMax, const int & yMin, const int & yMax, const int & window,
+				   const CRITICALNET & criticalNet, LAYER & layer, const vector<CONDUCTOR> & conductorInfo,
+				   const vector<CONDUCTOR> & changed, vector<DUMMY> & dummyInfo, LAYERSTAT & stat)
+{
+	STAGETIMER timer (stat.seconds);
+	auto progress = [&](const string & stage)
+	{
+		#pragma omp critical(progress)
+		{
+			cout << "[ Layer " << layer.layerID << " ] " << stage << endl; cout.flush();
 		}
 	};
+	layer.direction = layerDirection(layer, conductorInfo);
+	if(changed.empty())
+	{
+		progress("Unchanged");
+		return;
+	}
 
-	for(const auto & region : regions)
+	const int smallWindow = window / WINDOW_MOVING_STEP;
+	const long long align = tileAlign(layer, smallWindow);
+	auto lower = [&](long long value, int origin, int limit)
 	{
-		const int eLeft = (max<int>(region[0] - 1, 0) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
-		const int eBottom = (max<int>(region[1] - 1, 0) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
-		const int eRight = (min<int>(region[2] + 2, width + WINDOW_MOVING_STEP - 1) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
-		const int eTop = (min<int>(region[3] + 2, height + WINDOW_MOVING_STEP - 1) * (window / WINDOW_MOVING_STEP)) / layer.gridSize();
-		unordered_set<int> conductorID, dummyID;
-		unordered_map<int, CONDUCTOR> modifiedConductorInfo;
-		unordered_map<int, DUMMY> modifiedDummyInfo;
-		auto sortingID = [&](array<int, 2> a, array<int, 2> b)
+		return int(min<long long>(origin + (max<long long>(value, origin) - origin) / align * align, limit));
+	};
+	auto upper = [&](long long value, int origin, int limit)
+	{
+		return int(min<long long>(origin + (max<long long>(value, origin) - origin + align - 1) / align * align, limit));
+	};
+
+	// A previous fill overlapping a changed shape lies within one fill extent of it
+	int extent = layer.maxWidth;
+	for(const auto & dummy : dummyInfo)
+		extent = max<int>(extent, max<int>(dummy.right - dummy.left, dummy.top - dummy.bottom));
+	// New fills anchored up to one window around a zone are kept too, so that the windows
+	// across its border can be repaired; around those the solved box still covers a fill
+	// extent, SAFE_SPACING and one more window
+	const long long margin = window + extent;
+	const long long halo = max<long long>((SAFE_SPACING + window + margin + align - 1) / align, 1) * align;
+	vector<array<int, 4>> zone;
+	for(const auto & shape : changed)
+	{
+		const bool critical = criticalNet.netID.find(shape.netID) != criticalNet.netID.end();
+		const long long reach = window + max<long long>((long long)(extent) + layer.gridSize(), critical ? SAFE_SPACING : 0);
+		const array<int, 4> core {lower(shape.left - reach, xMin, xMax), lower(shape.bottom - reach, yMin, yMax),
+								  upper(shape.right + reach, xMin, xMax), upper(shape.top + reach, yMin, yMax)};
+		if(core[0] < core[2] && core[1] < core[3])
+			zone.emplace_back(core);
+	}
+	bool merged = true;
+	while(merged)
+	{
+		merged = false;
+		for(size_t a = 0; a < zone.size(); a++)
 		{
-			if(layer.direction == DIRECTION::Horizontal)
-			{
-				if(a[1] == 0 && b[1] == 0)
-				{
-					if(modifiedConductorInfo[a[0]].bottom == modifiedConductorInfo[b[0]].bottom)
-						return modifiedConductorInfo[a[0]].left < modifiedConductorInfo[b[0]].left;
-					else
-						return modifiedConductorInfo[a[0]].bottom < modifiedConductorInfo[b[0]].bottom;
-				}
-				else if(a[1] == 0 && b[1] == 1)
-				{
-					if(modifiedConductorInfo[a[0]].bottom == modifiedDummyInfo[b[0]].bottom)
-						return modifiedConductorInfo[a[0]].left < modifiedDummyInfo[b[0]].left;
-					else
-						return modifiedConductorInfo[a[0]].bottom < modifiedDummyInfo[b[0]].bottom;
-				}
-				else if(a[1] == 1 && b[1] == 0)
-				{
-					if(modifiedDummyInfo[a[0]].bottom == modifiedConductorInfo[b[0]].bottom)
-						return modifiedDummyInfo[a[0]].left < modifiedConductorInfo[b[0]].left;
-					else
-						return modifiedDummyInfo[a[0]].bottom < modifiedConductorInfo[b[0]].bottom;
-				}
-				else if(a[1] == 1 && b[1] == 1)
-				{
-					if(modifiedDummyInfo[a[0]].bottom == modifiedDummyInfo[b[0]].bottom)
-						return modifiedDummyInfo[a[0]].left < modifiedDummyInfo[b[0]].left;
-					else
-						return modifiedDummyInfo[a[0]].bottom < modifiedDummyInfo[b[0]].bottom;
-				}
-			}
-			else if(layer.direction == DIRECTION::Vertical)
+			for(size_t b = zone.size() - 1; b > a; b--)
 			{
-				if(a[1] == 0 && b[1] == 0)
-				{
-					if(modifiedConductorInfo[a[0]].left == modifiedConductorInfo[b[0]].left)
-						return modifiedConductorInfo[a[0]].bottom < modifiedConductorInfo[b[0]].bottom;
-					else
-						return modifiedConductorInfo[a[0]].left < modifiedConductorInfo[b[0]].left;
-				}
-				else if(a[1] == 0 && b[1] == 1)
-				{
-					if(modifiedConductorInfo[a[0]].left == modifiedDummyInfo[b[0]].left)
-						return modifiedConductorInfo[a[0]].bottom < modifiedDummyInfo[b[0]].bottom;
-					else
-						return modifiedConductorInfo[a[0]].left < modifiedDummyInfo[b[0]].left;
-				}
-				else if(a[1] == 1 && b[1] == 0)
-				{
-					if(modifiedDummyInfo[a[0]].left == modifiedConductorInfo[b[0]].left)
-						return modifiedDummyInfo[a[0]].bottom < modifiedConductorInfo[b[0]].bottom;
-					else
-						return modifiedDummyInfo[a[0]].left < modifiedConductorInfo[b[0]].left;
-				}
-				else if(a[1] == 1 && b[1] == 1)
+				if(zone[a][0] < zone[b][2] && zone[b][0] < zone[a][2] && zone[a][1] < zone[b][3] && zone[b][1] < zone[a][3])
 				{
-					if(modifiedDummyInfo[a[0]].left == modifiedDummyInfo[b[0]].left)
-						return modifiedDummyInfo[a[0]].bottom < modifiedDummyInfo[b[0]].bottom;
-					else
-						return modifiedDummyInfo[a[0]].left < modifiedDummyInfo[b[0]].left;
+					zone[a] = array<int, 4> {min<int>(zone[a][0], zone[b][0]), min<int>(zone[a][1], zone[b][1]),
+											 max<int>(zone[a][2], zone[b][2]), max<int>(zone[a][3], zone[b][3])};
+					zone.erase(zone.begin() + b);
+					merged = true;
 				}
 			}
-		};
-		for(int x = eLeft; x < eRight; x++)
+		}
+	}
+	sort(zone.begin(), zone.end(), [](const array<int, 4> & a, const array<int, 4> & b)
+	{
+		return a[1] != b[1] ? a[1] < b[1] : a[0] < b[0];
+	});
+	progress(to_string(zone.size()) + " ECO zones ...");
+
+	SPATIALINDEX conductorIndex, fillIndex;
+	conductorIndex.build(conductorInfo, layer.conductorID, xMin, yMin, xMax, yMax, smallWindow);
+	vector<int> previous (dummyInfo.size());
+	for(size_t id = 0; id < previous.size(); id++)
+		previous[id] = int(id);
+	fillIndex.build(dummyInfo, previous, xMin, yMin, xMax, yMax, smallWindow);
+
+	// Zones go one after another, each seeing the fills of the zones before it
+	vector<DUMMY> added;
+	vector<ARENA> regionArena;
+	for(const auto & core : zone)
+	{
+		const array<int, 4> box {int(max<long long>(core[0] - halo, xMin)), int(max<long long>(core[1] - halo, yMin)),
+								 int(min<long long>(core[2] + halo, xMax)), int(min<long long>(core[3] + halo, yMax))};
+		const array<int, 4> keep {int(max<long long>(core[0] - window, xMin)), int(max<long long>(core[1] - window, yMin)),
+								  int(min<long long>(core[2] + window, xMax)), int(min<long long>(core[3] + window, yMax))};
+		vector<int> conductorID;
+		conductorIndex.query(box, [&](int id) { conductorID.emplace_back(id); });
+		sort(conductorID.begin(), conductorID.end());
+
+		vector<DUMMY> fixed;
+		fillIndex.query(box, [&](int id)
 		{
-			for(int y = eBottom; y < eTop; y++)
+			DUMMY & dummy = dummyInfo[id];
+			if(!dummy.inserted)
+				return;
+			if(dummy.left >= core[0] && dummy.right <= core[2] && dummy.bottom >= core[1] && dummy.top <= core[3])
 			{
-				for(const auto & id : gridInfo[x][y].conductorID)
-				{
-					if(modifiedConductorInfo.find(id) == modifiedConductorInfo.end())
-					{
-						conductorID.emplace(id);
-						modifiedConductorInfo[id] = conductorInfo[id];
-						modifiedConductorInfo[id].left = max<int>(conductorInfo[id].left, eLeft * layer.gridSize() + xMin);
-						modifiedConductorInfo[id].bottom = max<int>(conductorInfo[id].bottom, eBottom * layer.gridSize() + yMin);
-						modifiedConductorInfo[id].right = min<int>(conductorInfo[id].right, eRight * layer.gridSize() + xMin);
-						modifiedConductorInfo[id].top = min<int>(conductorInfo[id].top, eTop * layer.gridSize() + yMin);
-					}
-				}
-				for(const auto & id : gridInfo[x][y].dummyID)
-				{
-					if(modifiedDummyInfo.find(id) == modifiedDummyInfo.end() && dummyInfo[id].inserted)
-					{
-						dummyID.emplace(id);
-						modifiedDummyInfo[id] = dummyInfo[id];
-						modifiedDummyInfo[id].left = max<int>(dummyInfo[id].left, eLeft * layer.gridSize() + xMin);
-						modifiedDummyInfo[id].bottom = max<int>(dummyInfo[id].bottom, eBottom * layer.gridSize() + yMin);
-						modifiedDummyInfo[id].right = min<int>(dummyInfo[id].right, eRight * layer.gridSize() + xMin);
-						modifiedDummyInfo[id].top = min<int>(dummyInfo[id].top, eTop * layer.gridSize() + yMin);
-					}
-				}
+				dummy.inserted = false;
+				stat.ecoDummiesRemoved++;
 			}
+			else
+				fixed.emplace_back(dummy);
+		});
+		for(const auto & dummy : added)
+		{
+			if(dummy.left < box[2] && dummy.right > box[0] && dummy.bottom < box[3] && dummy.top > box[1])
+				fixed.emplace_back(dummy);
 		}
-		vector<array<int, 2>> sortedID;
-		sortedID.reserve(modifiedConductorInfo.size() + modifiedDummyInfo.size());
-		for(const auto & id : conductorID)
-			sortedID.emplace_back(array<int, 2> {id, 0});
-		for(const auto & id : dummyID)
-			sortedID.emplace_back(array<int, 2> {id, 1});
-		sort(sortedID.begin(), sortedID.end(), sortingID);
 
-		if(layer.direction == DIRECTION::Horizontal)
+		const vector<DUMMY> kept = tileFill(box, keep, window, criticalNet, layer, conductorInfo,
+											IDRANGE {conductorID.data(), conductorID.data() + conductorID.size()}, fixed, stat, regionArena);
+		added.insert(added.end(), kept.begin(), kept.end());
+		stat.ecoZones++;
+	}
+
+	for(auto & dummy : added)
+	{
+		dummy.dummyID = int(dummyInfo.size());
+		dummyInfo.emplace_back(dummy);
+	}
+	progress("Done");
+}
+
+// Whether two rectangles are closer than spacing, overlapping and abutting ones included.
+// Facing edges are measured straight across and corners by Euclidean distance.
+template<typename A, typename B>
+bool tooClose(const A & a, const B & b, long long spacing)
+{
+	const long long dx = max<long long>((long long)(max<int>(a.left, b.left)) - min<int>(a.right, b.right), 0);
+	const long long dy = max<long long>((long long)(max<int>(a.bottom, b.bottom)) - min<int>(a.top, b.top), 0);
+	return dx * dx + dy * dy < spacing * spacing;
+}
+
+// Checks the fills in memory against the rules of every layer and prints a report: the
+// density range of the sliding windows with the worst ones on both sides, fill widths,
+// and the spacing of fills to fills and to conductors. The small-window areas (conductors
+// as a union, fills as they are) are gathered column by column in parallel from spatial
+// indexes and turned into window sums by DENSITYMAP; the fills are checked in parallel.
+// Returns whether every layer is clean.
+bool verifyFill(const int & xMin, const int & xMax, const int & yMin, const int & yMax, const int & window,
+				const vector<LAYER> & layerInfo, const vector<CONDUCTOR> & conductorInfo,
+				const vector<vector<DUMMY>> & dummyInfo)
+{
+	const int worstNum = 3;
+	const int smallWindow = window / WINDOW_MOVING_STEP;
+	const int latticeWidth = (xMax - xMin) / smallWindow, latticeHeight = (yMax - yMin) / smallWindow;
+	const int width = latticeWidth - WINDOW_MOVING_STEP + 1, height = latticeHeight - WINDOW_MOVING_STEP + 1;
+	const double windowArea = double(window) * window;
+	bool clean = true;
+
+	cout << "\n   -----   Verification   -----   " << endl;
+	for(size_t i = 1; i < layerInfo.size(); i++)
+	{
+		const LAYER & layer = layerInfo[i];
+		vector<int> fillID;
+		for(size_t id = 0; id < dummyInfo[i].size(); id++)
+			if(dummyInfo[i][id].inserted)
+				fillID.emplace_back(int(id));
+		SPATIALINDEX conductorIndex, fillIndex;
+		conductorIndex.build(conductorInfo, layer.conductorID, xMin, yMin, xMax, yMax, smallWindow);
+		fillIndex.build(dummyInfo[i], fillID, xMin, yMin, xMax, yMax, smallWindow);
+
+		long long windows = 0, belowMin = 0, aboveMax = 0;
+		vector<array<long long, 3>> lowest, highest;
+		if(width > 0 && height > 0)
 		{
-			array<int, 2> nowCombine = sortedID.front();
-			for(auto nowCheck = sortedID.begin() + 1; nowCheck != sortedID.end(); nowCheck++)
+			DENSITYMAP density (width, height, layer.minDensity, window);
+			#pragma omp parallel for schedule(dynamic, 1)
+			for(int X = 0; X < latticeWidth; X++)
 			{
-				if(nowCombine[1] == (*nowCheck)[1])
+				vector<array<int, 4>> rect;
+				for(int Y = 0; Y < latticeHeight; Y++)
 				{
-					if(nowCombine[1] == 0 &&
-					   modifiedConductorInfo[nowCombine[0]].bottom == modifiedConductorInfo[(*nowCheck)[0]].bottom &&
-					   modifiedConductorInfo[nowCombine[0]].top == modifiedConductorInfo[(*nowCheck)[0]].top &&
-					   modifiedConductorInfo[(*nowCheck)[0]].left - modifiedConductorInfo[nowCombine[0]].right < 3 * layer.gridSize())
+					const array<int, 4> box {xMin + X * smallWindow, yMin + Y * smallWindow,
+											 xMin + (X + 1) * smallWindow, yMin + (Y + 1) * smallWindow};
+					auto clip = [&](int left, int bottom, int right, int top)
 					{
-						modifiedConductorInfo[nowCombine[0]].right = modifiedConductorInfo[(*nowCheck)[0]].right;
-						(*nowCheck)[0] = -1;
-					}
-					else if(nowCombine[1] == 1 &&
-					    	modifiedDummyInfo[nowCombine[0]].bottom == modifiedDummyInfo[(*nowCheck)[0]].bottom &&
-					    	modifiedDummyInfo[nowCombine[0]].top == modifiedDummyInfo[(*nowCheck)[0]].top &&
-					    	modifiedDummyInfo[(*nowCheck)[0]].left - modifiedDummyInfo[nowCombine[0]].right < 3 * layer.gridSize())
+						return array<int, 4> {max<int>(left, box[0]), max<int>(bottom, box[1]), min<int>(right, box[2]), min<int>(top, box[3])};
+					};
+					rect.clear();
+					conductorIndex.query(box, [&](int id)
 					{
-						modifiedDummyInfo[nowCombine[0]].right = modifiedDummyInfo[(*nowCheck)[0]].right;
-						(*nowCheck)[0] = -1;
-					}
-					else
-						nowCombine = *nowCheck;
+						const CONDUCTOR & conductor = conductorInfo[id];
+						rect.emplace_back(clip(conductor.left, conductor.bottom, conductor.right, conductor.top));
+					});
+					long long area[2][2] = {{0, 0}, {0, 0}};
+					unionArea(rect, box[2], box[3], area);
+					long long total = area[0][0];
+					fillIndex.query(box, [&](int id)
+					{
+						const DUMMY & dummy = dummyInfo[i][id];
+						const array<int, 4> r = clip(dummy.left, dummy.bottom, dummy.right, dummy.top);
+						total += (long long)(r[2] - r[0]) * (r[3] - r[1]);
+					});
+					density.addOriginal(X, Y, total);
 				}
-				else
-					nowCombine = *nowCheck;
 			}
-			for(auto iter1 = sortedID.begin(); iter1 != sortedID.end(); iter1++)
+			density.build();
+
+			vector<array<long long, 3>> sums;
+			sums.reserve(size_t(width) * height);
+			for(int x = 0; x < width; x++)
 			{
-				if((*iter1)[0] == -1)
-					continue;
-				int bias;
-				vector<bool> boundary;
-				int total = 0;
-				if((*iter1)[1] == 0)
+				for(int y = 0; y < height; y++)
 				{
-					bias = modifiedConductorInfo[(*iter1)[0]].left + layer.gridSize();
-					int len = modifiedConductorInfo[(*iter1)[0]].right - layer.gridSize() - bias;
-					if(len < 0)
-						continue;
-					boundary.resize(len, false);
-				}
-				else
-				{
-					bias = modifiedDummyInfo[(*iter1)[0]].left + layer.gridSize();
-					int len = modifiedDummyInfo[(*iter1)[0]].right - layer.gridSize() - bias;
-					if(len < 0)
-						continue;
-					boundary.resize(len, false);
-				}
-				for(auto iter2 = iter1 + 1; iter2 != sortedID.end(); iter2++)
-				{
-					if((*iter2)[0] == -1)
-						continue;
-					int dist = distance(*iter1, *iter2), count = 0, xStart = -1;
-					bool overlap = false;
-					if(dist >= 0)
-					{
-						if((*iter2)[1] == 0)
-						{
-							for(int x = max<int>(modifiedConductorInfo[(*iter2)[0]].left - layer.gridSize() - bias, 0); x < min<int>(modifiedConductorInfo[(*iter2)[0]].right + layer.gridSize() - bias, boundary.size()); x++)
-							{
-								overlap = true;
-								if(boundary[x] == false)
-								{
-									if(xStart < 0)
-										xStart = x + bias;
-									boundary[x] = true;
-									count++;
-								}
-							}
-						}
-						else if((*iter2)[1] == 1)
-						{
-							for(int x = max<int>(modifiedDummyInfo[(*iter2)[0]].left - layer.gridSize() - bias, 0); x < min<int>(modifiedDummyInfo[(*iter2)[0]].right + layer.gridSize() - bias, boundary.size()); x++)
-							{
-								overlap = true;
-								if(boundary[x] == false)
-								{
-									if(xStart < 0)
-										xStart = x + bias;
-									boundary[x] = true;
-									count++;
-								}
-							}
-						}
-					}
-					else
-						continue;
-
-					total += count;
-					if(dist < 3 * layer.gridSize() || count < 3 * layer.gridSize() || !overlap)
-					{
-						if(boundary.size() - total < 3 * layer.gridSize())
-							break;
-						continue;
-					}
-					auto insert = [&](int yStart, int yEnd)
-					{
-						while(true)
-						{
-							int width = layer.maxWidth;
-							if(width > count)
-								width = count;
-							count -= (width + layer.gridSize());
-
-							DUMMY newDummy = {.inserted = true,
-											.dummyID = int(dummyInfo.size()),
-											.left = xStart,
-											.bottom = yStart,
-											.right = xStart + width,
-											.top = yEnd,
-											.layerID = layer.layerID};
-							dummyInfo.emplace_back(newDummy);
-							
-
-							xStart += (width + layer.gridSize());
-
-							if(count < layer.gridSize())
-								break;
-						}
-					};
-
-					if((*iter1)[1] == 0 && (*iter2)[1] == 0)
-					{
-						int yStart = modifiedConductorInfo[(*iter1)[0]].top + layer.gridSize();
-						int yEnd = modifiedConductorInfo[(*iter2)[0]].bottom - layer.gridSize();
-						insert(yStart, yEnd);
-					}
-					else if((*iter1)[1] == 0 && (*iter2)[1] == 1)
-					{
-						int yStart = modifiedConductorInfo[(*iter1)[0]].top + layer.gridSize();
-						int yEnd = modifiedDummyInfo[(*iter2)[0]].bottom - layer.gridSize();
-						insert(yStart, yEnd);
-					}
-					else if((*iter1)[1] == 1 && (*iter2)[1] == 0)
-					{
-						int yStart = modifiedDummyInfo[(*iter1)[0]].top + layer.gridSize();
-						int yEnd = modifiedConductorInfo[(*iter2)[0]].bottom - layer.gridSize();
-						insert(yStart, yEnd);
-					}
-					else if((*iter1)[1] == 1 && (*iter2)[1] == 1)
-					{
-						int yStart = modifiedDummyInfo[(*iter1)[0]].top + layer.gridSize();
-						int yEnd = modifiedDummyInfo[(*iter2)[0]].bottom - layer.gridSize();
-						insert(yStart, yEnd);
-					}
+					sums.emplace_back(array<long long, 3> {density.area(x, y), xMin + (long long)(x) * smallWindow, yMin + (long long)(y) * smallWindow});
+					belowMin += density.deficient(x, y);
+					aboveMax += (density.area(x, y) > double(layer.maxDensity) * windowArea);
 				}
 			}
+			windows = sums.size();
+			const size_t worst = min<size_t>(worstNum, sums.size());
+			partial_sort(sums.begin(), sums.begin() + worst, sums.end());
+			lowest.assign(sums.begin(), sums.begin() + worst);
+			partial_sort(sums.begin(), sums.begin() + worst, sums.end(), greater<array<long long, 3>> ());
+			highest.assign(sums.begin(), sums.begin() + worst);
 		}
-		else if(layer.direction == DIRECTION::Vertical)
+
+		long long narrow = 0, wide = 0, fillSpacing = 0, conductorSpacing = 0, outside = 0;
+		#pragma omp parallel for schedule(dynamic, 256) reduction(+ : narrow, wide, fillSpacing, conductorSpacing, outside)
+		for(size_t k = 0; k < fillID.size(); k++)
 		{
-			array<int, 2> nowCombine = sortedID.front();
-			for(auto nowCheck = sortedID.begin() + 1; nowCheck != sortedID.end(); nowCheck++)
+			const DUMMY & dummy = dummyInfo[i][fillID[k]];
+			const int shortSide = min<int>(dummy.right - dummy.left, dummy.top - dummy.bottom);
+			narrow += (shortSide < layer.minWidth);
+			wide += (shortSide > layer.maxWidth);
+			outside += (dummy.left < xMin || dummy.bottom < yMin || dummy.right > xMax || dummy.top > yMax);
+
+			const array<int, 4> reach {dummy.left - layer.minSpacing, dummy.bottom - layer.minSpacing,
+									   dummy.right + layer.minSpacing, dummy.top + layer.minSpacing};
+			conductorIndex.query(reach, [&](int id)
 			{
-				if(nowCombine[1] == (*nowCheck)[1])
-				{
-					if(nowCombine[1] == 0 &&
-					   modifiedConductorInfo[nowCombine[0]].left == modifiedConductorInfo[(*nowCheck)[0]].left &&
-					   modifiedConductorInfo[nowCombine[0]].right == modifiedConductorInfo[(*nowCheck)[0]].right &&
-					   modifiedConductorInfo[(*nowCheck)[0]].bottom - modifiedConductorInfo[nowCombine[0]].top < 3 * layer.gridSize())
-					{
-						modifiedConductorInfo[nowCombine[0]].top = modifiedConductorInfo[(*nowCheck)[0]].top;
-						(*nowCheck)[0] = -1;
-					}
-					else if(nowCombine[1] == 1 &&
-					    	modifiedDummyInfo[nowCombine[0]].left == modifiedDummyInfo[(*nowCheck)[0]].left &&
-					    	modifiedDummyInfo[nowCombine[0]].right == modifiedDummyInfo[(*nowCheck)[0]].right &&
-					    	modifiedDummyInfo[(*nowCheck)[0]].bottom - modifiedDummyInfo[nowCombine[0]].top < 3 * layer.gridSize())
-					{
-						modifiedDummyInfo[nowCombine[0]].top = modifiedDummyInfo[(*nowCheck)[0]].top;
-						(*nowCheck)[0] = -1;
-					}
-					else
-						nowCombine = *nowCheck;
-				}
-				else
-					nowCombine = *nowCheck;
-			}
-			for(auto iter1 = sortedID.begin(); iter1 != sortedID.end(); iter1++)
+				conductorSpacing += tooClose(dummy, conductorInfo[id], layer.minSpacing);
+			});
+			// Every pair of fills is counted once, from its lower ID
+			fillIndex.query(reach, [&](int id)
 			{
-				if((*iter1)[0] == -1)
-					continue;
-				int bias;
-				vector<bool> boundary;
-				int total = 0;
-				if((*iter1)[1] == 0)
-				{
-					bias = modifiedConductorInfo[(*iter1)[0]].bottom + layer.gridSize();
-					int len = modifiedConductorInfo[(*iter1)[0]].top - layer.gridSize() - bias;
-					if(len < 0)
-						continue;
-					boundary.resize(len, false);
-				}
-				else
-				{
-					bias = modifiedDummyInfo[(*iter1)[0]].bottom + layer.gridSize();
-					int len = modifiedDummyInfo[(*iter1)[0]].top - layer.gridSize() - bias;
-					if(len < 0)
-						continue;
-					boundary.resize(len, false);
-				}
-				for(auto iter2 = iter1 + 1; iter2 != sortedID.end(); iter2++)
-				{
-					if((*iter2)[0] == -1)
-						continue;
-					int dist = distance(*iter1, *iter2), count = 0, yStart = -1;
-					bool overlap = false;
-					if(dist >= 0)
-					{
-						if((*iter2)[1] == 0)
-						{
-							for(int y = max<int>(modifiedConductorInfo[(*iter2)[0]].bottom - layer.gridSize() - bias, 0); y < min<int>(modifiedConductorInfo[(*iter2)[0]].top + layer.gridSize() - bias, boundary.size()); y++)
-							{
-								overlap = true;
-								if(boundary[y] == false)
-								{
-									if(yStart < 0)
-										yStart = y + bias;
-									boundary[y] = true;
-									count++;
-								}
-							}
-						}
-						else if((*iter2)[1] == 1)
-						{
-							for(int y = max<int>(modifiedDummyInfo[(*iter2)[0]].bottom - layer.gridSize() - bias, 0); y < min<int>(modifiedDummyInfo[(*iter2)[0]].top + layer.gridSize() - bias, boundary.size()); y++)
-							{
-								overlap = true;
-								if(boundary[y] == false)
-								{
-									if(yStart < 0)
-										yStart = y + bias;
-									boundary[y] = true;
-									count++;
-								}
-							}
-						}
-					}
-					else
-						continue;
-					
-					total += count;
-					if(dist < 3 * layer.gridSize() || count < 3 * layer.gridSize() || !overlap)
-					{
-						if(boundary.size() - total < 3 * layer.gridSize())
-							break;
-						continue;
-					}
+				if(id > fillID[k])
+					fillSpacing += tooClose(dummy, dummyInfo[i][id], layer.minSpacing);
+			});
+		}
 
-					auto insert = [&](int xStart, int xEnd)
-					{
-						while(true)
-						{
-							int height = layer.maxWidth;
-							if(height > count)
-								height = count;
-							count -= (height + layer.gridSize());
-
-							DUMMY newDummy = {.inserted = true,
-											  .dummyID = int(dummyInfo.size()),
-											  .left = xStart,
-											  .bottom = yStart,
-											  .right = xEnd,
-											  .top = yStart + height,
-											  .layerID = layer.layerID};
-							dummyInfo.emplace_back(newDummy);
-							yStart += (height + layer.gridSize());
-
-							if(count < layer.gridSize())
-								break;
-						}
-					};
+		const bool layerClean = (belowMin + aboveMax + narrow + wide + fillSpacing + conductorSpacing + outside) == 0;
+		clean &= layerClean;
+		auto report = [&](const char * name, const vector<array<long long, 3>> & worst)
+		{
+			cout << "            " << name;
+			for(const auto & w : worst)
+				cout << "  (" << w[1] << ", " << w[2] << ") " << double(w[0]) / windowArea;
+			cout << endl;
+		};
+		cout << "[ Layer " << layer.layerID << " ] " << (layerClean ? "PASS" : "FAIL") << ": " << fillID.size() << " fills, "
+			 << windows << " windows" << endl
+			 << "            density " << (windows > 0 ? double(lowest.front()[0]) / windowArea : 0.0)
+			 << " .. " << (windows > 0 ? double(highest.front()[0]) / windowArea : 0.0)
+			 << " (rule " << layer.minDensity << " .. " << layer.maxDensity << "), "
+			 << belowMin << " below, " << aboveMax << " above" << endl;
+		report("lowest: ", lowest);
+		report("highest:", highest);
+		cout << "            width " << narrow << " below " << layer.minWidth << ", " << wide << " above " << layer.maxWidth
+			 << "; spacing " << fillSpacing << " fill-fill, " << conductorSpacing << " fill-conductor; "
+			 << outside << " outside the die" << endl;
+	}
+	return clean;
+}
 
-					if((*iter1)[1] == 0 && (*iter2)[1] == 0)
-					{
-						int xStart = modifiedConductorInfo[(*iter1)[0]].right + layer.gridSize();
-						int xEnd = modifiedConductorInfo[(*iter2)[0]].left - layer.gridSize();
-						insert(xStart, xEnd);
-					}
-					else if((*iter1)[1] == 0 && (*iter2)[1] == 1)
-					{
-						int xStart = modifiedConductorInfo[(*iter1)[0]].right + layer.gridSize();
-						int xEnd = modifiedDummyInfo[(*iter2)[0]].left - layer.gridSize();
-						insert(xStart, xEnd);
-					}
-					else if((*iter1)[1] == 1 && (*iter2)[1] == 0)
-					{
-						int xStart = modifiedDummyInfo[(*iter1)[0]].right + layer.gridSize();
-						int xEnd = modifiedConductorInfo[(*iter2)[0]].left - layer.gridSize();
-						insert(xStart, xEnd);
-					}
-					else if((*iter1)[1] == 1 && (*iter2)[1] == 1)
-					{
-						int xStart = modifiedDummyInfo[(*iter1)[0]].right + layer.gridSize();
-						int xEnd = modifiedDummyInfo[(*iter2)[0]].left - layer.gridSize();
-						insert(xStart, xEnd);
-					}
-				}
-			}
+void writeStage(ostream & output, const char * name, const STAGESTAT & stage, bool last = false)
+{
+	output << "        \"" << name << "\": {\"seconds\": " << stage.seconds
+		   << ", \"cellsScanned\": " << stage.cellsScanned << "}" << (last ? "\n" : ",\n");
+}
+
+bool writeStat(const char * file, const char * inputFile, const char * outputFile,
+			   int layerInFlight, double inputTime, double processTime, double outputTime,
+			   const vector<LAYER> & layerInfo, const vector<LAYERSTAT> & stat)
+{
+	ofstream output (file);
+	if(!output)
+	{
+		cerr << "Cannot open stats file " << file << endl;
+		return false;
+	}
+
+	// File names are written as given; the JSON escapes only cover quotes and backslashes
+	auto quoted = [](const char * text)
+	{
+		string result = "\"";
+		for(const char * p = text; *p != '\0'; p++)
+		{
+			if(*p == '"' || *p == '\\')
+				result += '\\';
+			result += *p;
 		}
+		return result + "\"";
+	};
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	output.precision(6);
+	output << fixed
+		   << "{\n"
+		   << "  \"input\": " << quoted(inputFile) << ",\n"
+		   << "  \"output\": " << quoted(outputFile) << ",\n"
+		   << "  \"threads\": " << omp_get_max_threads() << ",\n"
+		   << "  \"layersInFlight\": " << layerInFlight << ",\n"
+		   << "  \"inputSeconds\": " << inputTime << ",\n"
+		   << "  \"processSeconds\": " << processTime << ",\n"
+		   << "  \"outputSeconds\": " << outputTime << ",\n"
+		   << "  \"peakRssKB\": " << usage.ru_maxrss << ",\n"
+		   << "  \"layers\": [\n";
+	for(size_t i = 1; i < stat.size(); i++)
+	{
+		const LAYERSTAT & nowStat = stat[i];
+		output << "    {\n"
+			   << "      \"layer\": " << layerInfo[i].layerID << ",\n"
+			   << "      \"direction\": \"" << (layerInfo[i].direction == DIRECTION::Horizontal ? "Horizontal" : "Vertical") << "\",\n"
+			   << "      \"gridSize\": " << layerInfo[i].gridSize() << ",\n"
+			   << "      \"gridWidthNum\": " << nowStat.gridWidthNum << ",\n"
+			   << "      \"gridHeightNum\": " << nowStat.gridHeightNum << ",\n"
+			   << "      \"seconds\": " << nowStat.seconds << ",\n"
+			   << "      \"stages\": {\n";
+		writeStage(output, "gridCreation", nowStat.gridCreation);
+		writeStage(output, "dummyInsertion", nowStat.dummyInsertion);
+		writeStage(output, "densityMap", nowStat.densityMap);
+		writeStage(output, "critical", nowStat.critical);
+		writeStage(output, "regionExtraction", nowStat.regionExtraction);
+		writeStage(output, "regionFill", nowStat.regionFill, true);
+		output << "      },\n"
+			   << "      \"counters\": {\n"
+			   << "        \"queuePushes\": " << nowStat.queuePushes << ",\n"
+			   << "        \"queuePops\": " << nowStat.queuePops << ",\n"
+			   << "        \"dummiesCreated\": " << nowStat.dummiesCreated << ",\n"
+			   << "        \"dummiesReserved\": " << nowStat.dummiesReserved << ",\n"
+			   << "        \"dummiesPromoted\": " << nowStat.dummiesPromoted << ",\n"
+			   << "        \"insertionStrips\": " << nowStat.insertionStrips << ",\n"
+			   << "        \"seamMerges\": " << nowStat.seamMerges << ",\n"
+			   << "        \"regions\": " << nowStat.regions << ",\n"
+			   << "        \"regionDummies\": " << nowStat.regionDummies << ",\n"
+			   << "        \"tiles\": " << nowStat.tiles << ",\n"
+			   << "        \"tileDummiesDropped\": " << nowStat.tileDummiesDropped << ",\n"
+			   << "        \"ecoZones\": " << nowStat.ecoZones << ",\n"
+			   << "        \"ecoDummiesRemoved\": " << nowStat.ecoDummiesRemoved << ",\n"
+			   << "        \"cacheHits\": " << nowStat.cacheHits << "\n"
+			   << "      }\n"
+			   << "    }" << (i + 1 < stat.size() ? ",\n" : "\n");
 	}
+	output << "  ]\n"
+		   << "}\n";
+	return bool(output);
 }
 
-void writeFile(const char * file, const vector<vector<DUMMY>> & dummyInfo)
+struct OPTION
 {
-	fstream output;
-	output.open(file, ios::out);
+	const char * inputFile = nullptr;
+	const char * outputFile = nullptr;
+	// Upper bound of layers processed at the same time (0: one per OpenMP thread).
+	// Every layer in flight holds its own grid, so this also bounds peak memory.
+	int layerInFlight = 0;
+	// Write the binary fill format instead of text
+	bool binaryOutput = false;
+	// Only convert a binary fill file (inputFile) to text (outputFile)
+	bool convert = false;
+	// Per-layer timing / counter report (default: <output>.stats.json, "none" disables it)
+	string statFile;
+	// Tile edge in windows for the tiled streaming mode (0: whole die at once)
+	int tileWindow = 0;
+	// Check the fills against the layer rules once they are written; the report is
+	// informational and does not change the exit status. Tiled runs then keep the fills
+	// they stream out in memory as well.
+	bool verify = false;
+	// Strips of tracks dummyInsertion fills in parallel on whole-die runs (1: one pass).
+	// The fill is deterministic for a given count but differs slightly between counts.
+	int insertionStrips = 1;
+	// Per-layer result cache directory (empty: no cache) and its size cap in bytes
+	string cacheDirectory;
+	long long cacheLimit = 1024ll << 20;
+	// ECO re-fill: previous fill output of the input design and the conductor delta
+	const char * ecoFill = nullptr;
+	const char * ecoDelta = nullptr;
+};
 
-	for(const auto & dummys : dummyInfo)
+bool parseOption(int argc, char * argv[], OPTION & option)
+{
+	vector<const char *> positional;
+	for(int i = 1; i < argc; i++)
 	{
-		for(const auto & i : dummys)
+		const string arg = argv[i];
+		if(arg == "--layers-in-flight" && i + 1 < argc)
+			option.layerInFlight = max<int>(atoi(argv[++i]), 0);
+		else if(arg == "--binary")
+			option.binaryOutput = true;
+		else if(arg == "--convert")
+			option.convert = true;
+		else if(arg == "--verify")
+			option.verify = true;
+		else if(arg == "--stats" && i + 1 < argc)
+			option.statFile = argv[++i];
+		else if(arg == "--tile" && i + 1 < argc)
 		{
-			if(i.inserted)
-				output << i.left << " " << i.bottom << " " << i.right << " " << i.top << " " << i.layerID << endl;
+			option.tileWindow = atoi(argv[++i]);
+			if(option.tileWindow <= 0)
+				return false;
 		}
+		else if(arg == "--insertion-strips" && i + 1 < argc)
+		{
+			option.insertionStrips = atoi(argv[++i]);
+			if(option.insertionStrips <= 0)
+				return false;
+		}
+		else if(arg == "--cache" && i + 1 < argc)
+			option.cacheDirectory = argv[++i];
+		else if(arg == "--cache-limit" && i + 1 < argc)
+		{
+			option.cacheLimit = atoll(argv[++i]) << 20;
+			if(option.cacheLimit <= 0)
+				return false;
+		}
+		else if(arg == "--eco" && i + 2 < argc)
+		{
+			option.ecoFill = argv[++i];
+			option.ecoDelta = argv[++i];
+		}
+		else if(arg.size() > 2 && arg.compare(0, 2, "--") == 0)
+			return false;
+		else
+			positional.emplace_back(argv[i]);
 	}
-
-	output.close();
+	if(positional.size() != 2)
+		return false;
+
+	option.inputFile = positional[0];
+	option.outputFile = positional[1];
+	// Streamed binary output patches its header at the end, which a pipe cannot do
+	if(option.tileWindow > 0 && option.binaryOutput && string(option.outputFile) == "-")
+		return false;
+	if(option.tileWindow > 0 && option.ecoFill != nullptr)
+		return false;
+	// Tiles and ECO zones are filled in small boxes of their own, one pass each
+	if(option.insertionStrips > 1 && (option.tileWindow > 0 || option.ecoFill != nullptr))
+		return false;
+	// Only whole layers are cached
+	if(!option.cacheDirectory.empty() && (option.tileWindow > 0 || option.ecoFill != nullptr))
+		return false;
+	if(option.statFile.empty())
+		option.statFile = (string(option.outputFile) == "-") ? "none" : string(option.outputFile) + ".stats.json";
+	return true;
 }
 
 int main(int argc, char * argv[])
 {
+	OPTION option;
+	if(!parseOption(argc, argv, option))
+	{
+		cerr << "Usage: " << argv[0] << " <input> <output> [--layers-in-flight N] [--binary] [--stats FILE|none] [--verify] [--insertion-strips N] [--cache DIR [--cache-limit MB]] [--tile N | --eco <previous fill> <delta>]\n"
+			 << "       " << argv[0] << " --convert <binary fill> <text fill>" << endl;
+		return 1;
+	}
+	// Fills written to standard output must not be mixed with the progress, timing and
+	// verification reports, which go to standard error instead
+	if(string(option.outputFile) == "-")
+		cout.rdbuf(cerr.rdbuf());
+	if(option.convert)
+		return convertFile(option.inputFile, option.outputFile) ? 0 : 1;
+
 	auto inputStart = chrono::steady_clock::now();
 
 	int xMin, xMax, yMin, yMax, window, numCirtical, numLayer, numConductor;
 	CRITICALNET criticalNet;
 	vector<LAYER> layerInfo;
 	vector<CONDUCTOR> conductorInfo;
-	readFile(argv[1],
+	readFile(option.inputFile,
 			 xMin, xMax, yMin, yMax, window, numCirtical, numLayer, numConductor,
 			 criticalNet, layerInfo, conductorInfo);
 
+	vector<vector<DUMMY>> dummyInfo (numLayer + 1);
+	vector<vector<CONDUCTOR>> changed;
+	if(option.ecoFill != nullptr && !(readFill(option.ecoFill, numLayer, dummyInfo) &&
+									  readDelta(option.ecoDelta, numLayer, criticalNet, layerInfo, conductorInfo, changed)))
+		return 1;
+
 	auto inputEnd = chrono::steady_clock::now();
 
-	vector<vector<DUMMY>> dummyInfo (numLayer + 1);
-	for(int i = 1; i <= numLayer; i++)
+	// Layers are independent: each task owns its grid and its dummyInfo slot, and only
+	// reads the shared criticalNet / conductorInfo, so the output order is unaffected.
+	int layerInFlight = option.layerInFlight > 0 ? option.layerInFlight : omp_get_max_threads();
+	layerInFlight = max<int>(min<int>(layerInFlight, numLayer), 1);
+
+	vector<LAYERSTAT> stat (numLayer + 1);
+	bool written = true;
+	if(option.tileWindow > 0)
+	{
+		// Fills are written while the tiles finish, so the output time is part of processing
+		layerInFlight = 1;
+		cout << "\nProcessing " << numLayer << " layers in tiles of " << option.tileWindow << " windows" << endl;
+		FILLSTREAM output;
+		written = output.open(option.outputFile, numLayer, option.binaryOutput) &&
+				  tiledProcessing(xMin, xMax, yMin, yMax, window, option.tileWindow,
+								  criticalNet, layerInfo, conductorInfo, output, stat, dummyInfo, option.verify);
+		if(output.output != nullptr)
+			written &= output.close();
+		if(!written)
+			cerr << "Failed writing output file " << option.outputFile << endl;
+	}
+	else
 	{
-		cout << "\n[ Layer " << i << " ]" << endl; cout.flush();
-		cout << "Grid Creation ..." << endl; cout.flush();
-		vector<vector<GRID>> gridInfo = gridCreation(xMin, xMax, yMin, yMax, window,
-													 criticalNet, layerInfo[i], conductorInfo);
-		cout << "Dummy Fill Insertion ..." << endl; cout.flush();
-		dummyInsertion(dummyInfo[i], xMax, yMax, gridInfo, layerInfo[i], conductorInfo);
-		cout << "Density Refinement ..." << endl; cout.flush();
-		densityRefinement((xMax - xMin) / (window / WINDOW_MOVING_STEP) - WINDOW_MOVING_STEP + 1,
-						  (yMax - yMin) / (window / WINDOW_MOVING_STEP) - WINDOW_MOVING_STEP + 1,
-						  window, dummyInfo[i], xMin, xMax, yMin, yMax, gridInfo, layerInfo[i], conductorInfo);
+		if(option.ecoFill != nullptr)
+			cout << "\nRe-filling " << numLayer << " layers of " << option.ecoFill << " after " << option.ecoDelta << ", " << layerInFlight << " in flight" << endl;
+		else
+			cout << "\nProcessing " << numLayer << " layers, " << layerInFlight << " in flight" << endl;
+		if(!option.cacheDirectory.empty())
+			mkdir(option.cacheDirectory.c_str(), 0777);
+		// One nested level lets a layer spread its region fill over the threads left idle
+		omp_set_max_active_levels(2);
+		#pragma omp parallel num_threads(layerInFlight)
+		#pragma omp single
+		for(int i = 1; i <= numLayer; i++)
+		{
+			#pragma omp task firstprivate(i) shared(criticalNet, layerInfo, conductorInfo, dummyInfo, changed, stat)
+			{
+				if(option.ecoFill != nullptr)
+					ecoProcessing(xMin, xMax, yMin, yMax, window,
+								  criticalNet, layerInfo[i], conductorInfo, changed[i], dummyInfo[i], stat[i]);
+				else
+				{
+					const string entry = option.cacheDirectory.empty() ? string() :
+						cacheEntry(option.cacheDirectory, xMin, xMax, yMin, yMax, window,
+								   criticalNet, layerInfo[i], conductorInfo, option.insertionStrips);
+					STAGETIMER timer (stat[i].seconds);
+					if(!entry.empty() && loadCache(entry, layerInfo[i], dummyInfo[i]))
+					{
+						// gridCreation is skipped, so the direction the stats report is decided here
+						layerInfo[i].direction = layerDirection(layerInfo[i], conductorInfo);
+						stat[i].cacheHits++;
+						#pragma omp critical(progress)
+						{
+							cout << "[ Layer " << layerInfo[i].layerID << " ] Cached" << endl; cout.flush();
+						}
+					}
+					else
+					{
+						timer.stop();
+						layerProcessing(xMin, xMax, yMin, yMax, window,
+										criticalNet, layerInfo[i], conductorInfo, dummyInfo[i], stat[i], option.insertionStrips);
+						if(!entry.empty())
+							storeCache(entry, layerInfo[i], dummyInfo[i]);
+					}
+				}
+			}
+		}
+		if(!option.cacheDirectory.empty())
+			trimCache(option.cacheDirectory, option.cacheLimit);
 	}
 
 	auto outputStart = chrono::steady_clock::now();
 
-	writeFile(argv[2], dummyInfo);
+	if(option.tileWindow == 0)
+		written = writeFile(option.outputFile, dummyInfo, option.binaryOutput);
 
 	auto outputEnd = chrono::steady_clock::now();
 
@@ -1414,4 +3607,25 @@ int main(int argc, char * argv[])
 		 << "  Input Time:\t\t" << chrono::duration<float>(inputEnd - inputStart).count() << "\tsec." << endl
 		 << "+ Output Time:\t\t" << chrono::duration<float>(outputEnd - outputStart).count() << "\tsec." << endl
 		 << "= Total Runtime:\t" << chrono::duration<float>(outputEnd - inputStart).count() << "\tsec." << endl << endl;
-}
\ No newline at end of file
+
+	if(option.verify)
+	{
+		auto verifyStart = chrono::steady_clock::now();
+		const bool clean = verifyFill(xMin, xMax, yMin, yMax, window, layerInfo, conductorInfo, dummyInfo);
+		cout << (clean ? "All layers pass" : "Rule violations found") << ", verified in "
+			 << chrono::duration<float>(chrono::steady_clock::now() - verifyStart).count() << " sec." << endl << endl;
+	}
+
+	bool statWritten = true;
+	if(option.statFile != "none")
+	{
+		statWritten = writeStat(option.statFile.c_str(), option.inputFile, option.outputFile, layerInFlight,
+								chrono::duration<double>(inputEnd - inputStart).count(),
+								chrono::duration<double>(outputStart - inputEnd).count(),
+								chrono::duration<double>(outputEnd - outputStart).count(),
+								layerInfo, stat);
+		cout << "Stage statistics written to " << option.statFile << endl;
+	}
+
+	return (written && statWritten) ? 0 : 1;
+}
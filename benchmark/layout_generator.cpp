@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Writes a synthetic layout in the input format read by Fill_Insertion's readFile:
+//   xMin yMin xMax yMax window
+//   numCritical numLayer numConductor
+//   <numCritical critical net IDs>
+//   layerID minWidth minSpacing maxWidth minDensity maxDensity weight   (one per layer)
+//   conductorID left bottom right top netID layerID                     (one per conductor)
+
+enum ROUTING { Horizontal, Vertical, Alternate };
+
+struct GENOPTION
+{
+	int dieWidth = 100000, dieHeight = 100000, window = 8000, numLayer = 3, numNet = 1000;
+	int minWidth = 60, minSpacing = 60, maxWidth = 1500;
+	float minDensity = 0.4f, maxDensity = 0.8f, weight = 1.0f;
+	// Target fraction of the die covered by conductors on each layer
+	float density = 0.25f;
+	// Fraction of nets marked critical
+	float critical = 0.1f;
+	ROUTING routing = ROUTING::Alternate;
+	unsigned seed = 1;
+	const char * outputFile = "-";
+};
+
+struct RECT
+{
+	int left, bottom, right, top, netID, layerID;
+};
+
+bool parseOption(int argc, char * argv[], GENOPTION & option)
+{
+	for(int i = 1; i < argc; i++)
+	{
+		const string arg = argv[i];
+		if(i + 1 >= argc)
+			return false;
+		const char * value = argv[++i];
+		if(arg == "--die")
+		{
+			if(i + 1 >= argc)
+				return false;
+			option.dieWidth = atoi(value);
+			option.dieHeight = atoi(argv[++i]);
+		}
+		else if(arg == "--window")
+			option.window = atoi(value);
+		else if(arg == "--layers")
+			option.numLayer = atoi(value);
+		else if(arg == "--nets")
+			option.numNet = atoi(value);
+		else if(arg == "--min-width")
+			option.minWidth = atoi(value);
+		else if(arg == "--min-spacing")
+			option.minSpacing = atoi(value);
+		else if(arg == "--max-width")
+			option.maxWidth = atoi(value);
+		else if(arg == "--min-density")
+			option.minDensity = float(atof(value));
+		else if(arg == "--max-density")
+			option.maxDensity = float(atof(value));
+		else if(arg == "--density")
+			option.density = float(atof(value));
+		else if(arg == "--critical")
+			option.critical = float(atof(value));
+		else if(arg == "--direction")
+		{
+			const string direction = value;
+			if(direction == "horizontal")
+				option.routing = ROUTING::Horizontal;
+			else if(direction == "vertical")
+				option.routing = ROUTING::Vertical;
+			else if(direction == "alternate")
+				option.routing = ROUTING::Alternate;
+			else
+				return false;
+		}
+		else if(arg == "--seed")
+			option.seed = unsigned(strtoul(value, nullptr, 10));
+		else if(arg == "--output")
+			option.outputFile = value;
+		else
+			return false;
+	}
+
+	return option.dieWidth > 0 && option.dieHeight > 0 && option.window >= 4 && option.numLayer > 0 &&
+		   option.numNet > 0 && option.minWidth > 0 && option.minSpacing > 0 && option.maxWidth >= option.minWidth &&
+		   option.density >= 0 && option.density < 1 && option.critical >= 0 && option.critical <= 1;
+}
+
+// Lays wires on parallel tracks in the preferred direction. The track pitch and the
+// fraction of each track that is occupied are chosen so that the covered area
+// approaches option.density; segments on a track keep at least minSpacing apart.
+void generateLayer(const GENOPTION & option, int layerID, bool horizontal, mt19937 & random, vector<RECT> & conductor)
+{
+	const int along = horizontal ? option.dieWidth : option.dieHeight;
+	const int across = horizontal ? option.dieHeight : option.dieWidth;
+	const int wireWidth = option.minWidth;
+	int pitch = 2 * (option.minWidth + option.minSpacing);
+	float occupancy = option.density * pitch / (wireWidth * 1.5f);
+	if(occupancy > 0.9f)
+	{
+		pitch = option.minWidth + option.minSpacing + option.minWidth;
+		occupancy = min<float>(option.density * pitch / (wireWidth * 1.5f), 0.95f);
+	}
+
+	uniform_int_distribution<int> netDistribution (1, option.numNet);
+	uniform_int_distribution<int> widthDistribution (1, 2);
+	uniform_real_distribution<float> unit (0.0f, 1.0f);
+	const int longest = max<int>(along / 4, 10 * wireWidth);
+	uniform_int_distribution<int> lengthDistribution (4 * wireWidth, longest);
+
+	for(int track = option.minSpacing; track + 2 * wireWidth <= across; track += pitch)
+	{
+		int position = 0;
+		while(position < along)
+		{
+			const int length = lengthDistribution(random);
+			// Gap sized so that, on average, occupancy of the track is covered by wires
+			const int gap = max<int>(option.minSpacing, int(length * (1.0f - occupancy) / max<float>(occupancy, 0.01f) * 2.0f * unit(random)));
+			const int start = position + gap;
+			const int end = min<int>(start + length, along);
+			if(end - start >= wireWidth)
+			{
+				const int width = wireWidth * widthDistribution(random);
+				RECT rect;
+				if(horizontal)
+					rect = RECT {start, track, end, min<int>(track + width, across), netDistribution(random), layerID};
+				else
+					rect = RECT {track, start, min<int>(track + width, across), end, netDistribution(random), layerID};
+				conductor.emplace_back(rect);
+			}
+			position = end;
+		}
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	GENOPTION option;
+	if(!parseOption(argc, argv, option))
+	{
+		cerr << "Usage: " << argv[0] << " [--die W H] [--window N] [--layers N] [--nets N]\n"
+			 << "       [--min-width N] [--min-spacing N] [--max-width N] [--min-density F] [--max-density F]\n"
+			 << "       [--density F] [--critical F] [--direction horizontal|vertical|alternate]\n"
+			 << "       [--seed N] [--output FILE]" << endl;
+		return 1;
+	}
+
+	mt19937 random (option.seed);
+	vector<RECT> conductor;
+	for(int layer = 1; layer <= option.numLayer; layer++)
+	{
+		bool horizontal = (option.routing == ROUTING::Horizontal);
+		if(option.routing == ROUTING::Alternate)
+			horizontal = (layer % 2 == 1);
+		generateLayer(option, layer, horizontal, random, conductor);
+	}
+
+	vector<int> criticalNet;
+	uniform_real_distribution<float> unit (0.0f, 1.0f);
+	for(int net = 1; net <= option.numNet; net++)
+	{
+		if(unit(random) < option.critical)
+			criticalNet.emplace_back(net);
+	}
+
+	const bool standardOutput = (string(option.outputFile) == "-");
+	ofstream file;
+	if(!standardOutput)
+	{
+		file.open(option.outputFile);
+		if(!file)
+		{
+			cerr << "Cannot open output file " << option.outputFile << endl;
+			return 1;
+		}
+	}
+	ostream & output = standardOutput ? cout : file;
+
+	output << "0 0 " << option.dieWidth << " " << option.dieHeight << " " << option.window << "\n"
+		   << criticalNet.size() << " " << option.numLayer << " " << conductor.size() << "\n";
+	for(size_t i = 0; i < criticalNet.size(); i++)
+		output << criticalNet[i] << (i + 1 < criticalNet.size() ? " " : "");
+	output << "\n";
+	for(int layer = 1; layer <= option.numLayer; layer++)
+		output << layer << " " << option.minWidth << " " << option.minSpacing << " " << option.maxWidth << " "
+			   << option.minDensity << " " << option.maxDensity << " " << option.weight << "\n";
+	for(size_t i = 0; i < conductor.size(); i++)
+	{
+		const RECT & rect = conductor[i];
+		output << i + 1 << " " << rect.left << " " << rect.bottom << " " << rect.right << " " << rect.top << " "
+			   << rect.netID << " " << rect.layerID << "\n";
+	}
+
+	output.flush();
+	return output ? 0 : 1;
+}
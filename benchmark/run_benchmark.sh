@@ -0,0 +1,81 @@
+#!/bin/bash
+# Sweeps synthetic layouts through Fill_Insertion and appends one CSV row per run with
+# the per-stage time (summed over layers) and the peak RSS taken from the stats report.
+#
+# Every sweep axis can be overridden from the environment, e.g.
+#   DIES="200000" LAYERS="9" DENSITIES="0.1 0.3" ./benchmark/run_benchmark.sh
+
+EXE=${EXE:-./Fill_Insertion}
+GEN=${GEN:-./Layout_Generator}
+WORK=${WORK:-./benchmark/work}
+RESULT=${RESULT:-./benchmark/results.csv}
+
+DIES=${DIES:-"50000 100000"}
+WINDOWS=${WINDOWS:-"8000"}
+LAYERS=${LAYERS:-"3"}
+DENSITIES=${DENSITIES:-"0.2 0.4"}
+CRITICALS=${CRITICALS:-"0.05 0.2"}
+DIRECTIONS=${DIRECTIONS:-"alternate"}
+SEEDS=${SEEDS:-"1"}
+EXTRA=${EXTRA:-""}
+
+for tool in "$EXE" "$GEN"; do
+	if [ ! -x "$tool" ]; then
+		echo "Missing $tool, run 'make opt gen' first" >&2
+		exit 1
+	fi
+done
+
+mkdir -p "$WORK"
+if [ ! -f "$RESULT" ]; then
+	echo "die,window,layers,density,critical,direction,seed,conductors,fills,input_s,process_s,output_s,gridCreation_s,dummyInsertion_s,densityMap_s,critical_s,regionExtraction_s,regionFill_s,peak_rss_kb" > "$RESULT"
+fi
+
+for die in $DIES; do
+for window in $WINDOWS; do
+for layers in $LAYERS; do
+for density in $DENSITIES; do
+for critical in $CRITICALS; do
+for direction in $DIRECTIONS; do
+for seed in $SEEDS; do
+	name="d${die}_w${window}_l${layers}_c${density}_k${critical}_${direction}_s${seed}"
+	input="$WORK/$name.txt"
+	output="$WORK/$name.out"
+	stats="$WORK/$name.json"
+
+	"$GEN" --die "$die" "$die" --window "$window" --layers "$layers" --density "$density" \
+		   --critical "$critical" --direction "$direction" --seed "$seed" --output "$input" || exit 1
+	echo "Running $name ..."
+	if ! "$EXE" "$input" "$output" --stats "$stats" $EXTRA > "$WORK/$name.log"; then
+		echo "  failed, see $WORK/$name.log" >&2
+		continue
+	fi
+
+	conductors=$(awk 'NR == 2 { print $3; exit }' "$input")
+	fills=$(wc -l < "$output")
+	summary=$(awk '
+		/"inputSeconds"/   { gsub(/,/, "", $2); input = $2 }
+		/"processSeconds"/ { gsub(/,/, "", $2); process = $2 }
+		/"outputSeconds"/  { gsub(/,/, "", $2); output = $2 }
+		/"peakRssKB"/      { gsub(/,/, "", $2); rss = $2 }
+		/"cellsScanned"/ {
+			stage = $1; gsub(/[":]/, "", stage)
+			seconds = $3; gsub(/,/, "", seconds)
+			sum[stage] += seconds
+		}
+		END {
+			printf "%s,%s,%s,%f,%f,%f,%f,%f,%f,%s", input, process, output,
+				   sum["gridCreation"], sum["dummyInsertion"], sum["densityMap"],
+				   sum["critical"], sum["regionExtraction"], sum["regionFill"], rss
+		}' "$stats")
+	echo "$die,$window,$layers,$density,$critical,$direction,$seed,$conductors,$fills,$summary" >> "$RESULT"
+	tail -n 1 "$RESULT"
+done
+done
+done
+done
+done
+done
+done
+
+echo "Results appended to $RESULT"
@@ -0,0 +1,61 @@
+#!/bin/bash
+# Checks the tiled mode against the whole-die run: every synthetic layout is filled
+# untiled and with each tile size under --verify, and a tiled run fails the check when a
+# layer ends up with more windows below minDensity than the untiled run of that layer.
+# Exits non-zero if any run fails.
+#
+# The layouts can be overridden from the environment, e.g.
+#   DIES="120000" TILES="1 2" SEEDS="1 2 3" ./benchmark/tile_verify.sh
+
+EXE=${EXE:-./Fill_Insertion}
+GEN=${GEN:-./Layout_Generator}
+WORK=${WORK:-./benchmark/work}
+
+DIES=${DIES:-"60000 120000"}
+WINDOWS=${WINDOWS:-"8000"}
+DENSITIES=${DENSITIES:-"0.2 0.3"}
+TILES=${TILES:-"1 2 3 4"}
+SEEDS=${SEEDS:-"1"}
+
+for tool in "$EXE" "$GEN"; do
+	if [ ! -x "$tool" ]; then
+		echo "Missing $tool, run 'make opt gen' first" >&2
+		exit 1
+	fi
+done
+
+mkdir -p "$WORK"
+
+# Windows below minDensity of every layer, one count per line, from a --verify report
+below() {
+	grep -o '[0-9]* below,' "$1" | awk '{ print $1 }'
+}
+
+failed=0
+for die in $DIES; do
+for window in $WINDOWS; do
+for density in $DENSITIES; do
+for seed in $SEEDS; do
+	name="tile_d${die}_w${window}_c${density}_s${seed}"
+	input="$WORK/$name.txt"
+	"$GEN" --die "$die" "$die" --window "$window" --layers 3 --density "$density" \
+		   --critical 0.2 --seed "$seed" --output "$input" > /dev/null || exit 1
+
+	"$EXE" "$input" "$WORK/$name.out" --verify --stats none > "$WORK/$name.log" || exit 1
+	below "$WORK/$name.log" > "$WORK/$name.below"
+	for tile in $TILES; do
+		log="$WORK/${name}_t$tile.log"
+		"$EXE" "$input" "$WORK/${name}_t$tile.out" --tile "$tile" --verify --stats none > "$log" || exit 1
+		if ! paste "$WORK/$name.below" <(below "$log") | awk '$2 > $1 { worse = 1 } END { exit worse }'; then
+			echo "$name --tile $tile: more windows below minDensity than untiled, see $log"
+			failed=1
+		else
+			echo "$name --tile $tile: ok"
+		fi
+	done
+done
+done
+done
+done
+
+exit $failed